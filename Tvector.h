@@ -2,39 +2,102 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <shared_mutex>
+#include <optional>
 #include <type_traits>
 #include<chrono>
 #include <algorithm>
 #include <queue>
+#include <deque>
+#include <iterator>
+#include <memory>
 #include <condition_variable>
 #include <stdexcept>
 #include<stack>
+#if __has_include(<span>) && __cplusplus > 201703L
+#include <span>
+#endif
+
+#include "parallel_alghr.h"
+
+// Contiguous view of the elements: std::span under C++20, otherwise the
+// part of it the locked views need
+#if defined(__cpp_lib_span)
+template<typename T>
+using tvector_span = std::span<T>;
+#else
+template<typename T>
+class tvector_span
+{
+private:
+	T* ptr = nullptr;
+	std::size_t count = 0;
+
+public:
+	tvector_span() = default;
+	tvector_span(T* data_, std::size_t size_) : ptr(data_), count(size_) {}
+
+	T* data() const { return ptr; }
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T* begin() const { return ptr; }
+	T* end() const { return ptr + count; }
+	T& operator[](std::size_t index) const { return ptr[index]; }
+};
+#endif
+
+// A span of a Tvector together with the lock that keeps it valid:
+// exclusive (std::unique_lock) for a mutable Tvector, shared for a const
+// one. The Tvector is locked until the view is destroyed.
+template<typename T, typename Lock>
+class locked_view
+{
+private:
+	Lock lock;
+	tvector_span<T> elements;
+
+public:
+	locked_view(Lock lock_, tvector_span<T> elements_) : lock(std::move(lock_)), elements(elements_) {}
+
+	tvector_span<T> span() const { return elements; }
+	T* data() const { return elements.data(); }
+	std::size_t size() const { return elements.size(); }
+	bool empty() const { return elements.empty(); }
+	T* begin() const { return elements.data(); }
+	T* end() const { return elements.data() + elements.size(); }
+	T& operator[](std::size_t index) const { return elements.data()[index]; }
+};
 
 template<typename T = int> 
 class Tvector
 {
 private:
 	std::vector<T> vec;
-	mutable std::mutex mute;
+	mutable std::shared_mutex mute;
 
+	template<typename U, typename V, typename UnaryOperation>
+	friend void transform_parallel(const Tvector<U>& in, Tvector<V>& out, UnaryOperation op);
+
+	// Locks for every single step and hands out a reference that outlives
+	// the lock; for a pass over the elements use with_lock/locked_span
 	class iterator
 	{
 	private:
 		friend class Tvector<T>;
 		typename std::vector<T>::iterator iter;
-		std::mutex& mute_iter;
+		std::shared_mutex& mute_iter;
 
 	public:
-		iterator(typename std::vector<T>::iterator it, std::mutex& mtx):iter(it),mute_iter(mtx){}
+		iterator(typename std::vector<T>::iterator it, std::shared_mutex& mtx):iter(it),mute_iter(mtx){}
 
 		T& operator*()
 		{
-			std::lock_guard<std::mutex> lock_push(mute_iter);			
+			std::lock_guard<std::shared_mutex> lock_push(mute_iter);			
 			return *iter;
 		}
 		iterator& operator++()
 		{
-			std::lock_guard<std::mutex> lock_push(mute_iter);
+			std::lock_guard<std::shared_mutex> lock_push(mute_iter);
 			++iter;
 			return *this;
 		}
@@ -54,17 +117,17 @@ public:
 	}
 	Tvector(const Tvector& other)
 	{
-		std::lock_guard<std::mutex> lock_push(other.mute);
+		std::shared_lock<std::shared_mutex> lock_push(other.mute);
 		vec = other.vec;
 	}
 	Tvector(Tvector&& other)
 	{
-		std::lock_guard<std::mutex> lock_push(other.mute);
+		std::lock_guard<std::shared_mutex> lock_push(other.mute);
 		vec = std::move(other.vec);
 	}
 	Tvector& operator= (const Tvector& obj)
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
+		std::lock_guard<std::shared_mutex> lock_push(mute);
 		if (this != &obj)
 		{
 			vec = obj.vec; 
@@ -73,7 +136,7 @@ public:
 	}
 	Tvector& operator= ( Tvector&& obj)
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
+		std::lock_guard<std::shared_mutex> lock_push(mute);
 		if (this != &obj)
 		{
 			vec = std::move(obj.vec);
@@ -82,50 +145,82 @@ public:
 	}
 	T operator[](std::size_t index) const
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
+		std::shared_lock<std::shared_mutex> lock_push(mute);
 		return vec[index];
 	}
 	std::size_t size() const 
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
+		std::shared_lock<std::shared_mutex> lock_push(mute);
 		return vec.size();
 	}
 	void resize(std::size_t newsise)
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
+		std::lock_guard<std::shared_mutex> lock_push(mute);
 		vec.resize(newsise);
 	}
 	void push_back(const T& value)
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
+		std::lock_guard<std::shared_mutex> lock_push(mute);
 		vec.emplace_back(value);
 	}
 	template< typename Iterator>
 	void insert(iterator where, Iterator begin, Iterator end)
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
+		std::lock_guard<std::shared_mutex> lock_push(mute);
 		auto it = where.iter;
 		vec.insert(it,begin,end);
 
 	}
 	void erase(const std::size_t index)
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
+		std::lock_guard<std::shared_mutex> lock_push(mute);
 		auto it = vec.begin() + index;
 		vec.erase(it);
 	}
 	constexpr T get_max() const
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
-		const auto t = std::max_element(vec.begin(), vec.end());
+		std::shared_lock<std::shared_mutex> lock_push(mute);
+		const auto t = max_element_parallel(vec.begin(), vec.end());
 		return *t;
 	}
 	constexpr T get_min() const
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
-		const auto t = std::min_element(vec.begin(), vec.end());
+		std::shared_lock<std::shared_mutex> lock_push(mute);
+		const auto t = min_element_parallel(vec.begin(), vec.end());
 		return *t;
 	}
+	// Both in a single pass: {min, max}
+	std::pair<T, T> get_minmax() const
+	{
+		std::shared_lock<std::shared_mutex> lock_push(mute);
+		const auto t = minmax_element_parallel(vec.begin(), vec.end());
+		return { *t.first, *t.second };
+	}
+	// Takes the lock once and calls fn(span) with all the elements:
+	// exclusive on a mutable Tvector, shared on a const one (std::as_const
+	// for a read-only pass). fn must not call back into this Tvector.
+	template<typename Func>
+	decltype(auto) with_lock(Func fn)
+	{
+		std::lock_guard<std::shared_mutex> lock_push(mute);
+		return fn(tvector_span<T>(vec.data(), vec.size()));
+	}
+	template<typename Func>
+	decltype(auto) with_lock(Func fn) const
+	{
+		std::shared_lock<std::shared_mutex> lock_push(mute);
+		return fn(tvector_span<const T>(vec.data(), vec.size()));
+	}
+	locked_view<T, std::unique_lock<std::shared_mutex>> locked_span()
+	{
+		std::unique_lock<std::shared_mutex> lock(mute);
+		return { std::move(lock), tvector_span<T>(vec.data(), vec.size()) };
+	}
+	locked_view<const T, std::shared_lock<std::shared_mutex>> locked_span() const
+	{
+		std::shared_lock<std::shared_mutex> lock(mute);
+		return { std::move(lock), tvector_span<const T>(vec.data(), vec.size()) };
+	}
 	iterator begin()
 	{
 		return iterator(vec.begin(), mute);
@@ -136,55 +231,237 @@ public:
 	}
 	void clear()
 	{
-		std::lock_guard<std::mutex> lock_push(mute);
+		std::lock_guard<std::shared_mutex> lock_push(mute);
 		vec.clear();
 	}
 };
 
 
+// The *_parallel algorithms on a whole Tvector under one lock, on the raw
+// elements, so they run at std::vector speed. Results are values or
+// indices, iterators would outlive the lock.
+template<typename T, typename U>
+U accumulate_parallel(const Tvector<T>& v, U init)
+{
+	return v.with_lock([&init](tvector_span<const T> s) { return accumulate_parallel(s.data(), s.data() + s.size(), init); });
+}
+
+// in place, under the exclusive lock
+template<typename T, typename UnaryOperation>
+void transform_parallel(Tvector<T>& v, UnaryOperation op)
+{
+	v.with_lock([&op](tvector_span<T> s) { transform_parallel(s.data(), s.data() + s.size(), s.data(), op); });
+}
+
+template<typename T, typename OutputIt, typename UnaryOperation>
+OutputIt transform_parallel(const Tvector<T>& in, OutputIt d_first, UnaryOperation op)
+{
+	return in.with_lock([&](tvector_span<const T> s)
+	{
+		transform_parallel(s.data(), s.data() + s.size(), d_first, op);
+		return std::next(d_first, s.size());
+	});
+}
+
+// out is resized to in.size(); the two locks are taken in address order,
+// so two opposite calls can't deadlock
+template<typename U, typename V, typename UnaryOperation>
+void transform_parallel(const Tvector<U>& in, Tvector<V>& out, UnaryOperation op)
+{
+	if constexpr (std::is_same_v<U, V>)
+	{
+		if (&in == &out)
+		{
+			std::lock_guard<std::shared_mutex> lock(out.mute);
+			transform_parallel(out.vec.data(), out.vec.data() + out.vec.size(), out.vec.data(), op);
+			return;
+		}
+	}
+	std::shared_lock<std::shared_mutex> in_lock(in.mute, std::defer_lock);
+	std::unique_lock<std::shared_mutex> out_lock(out.mute, std::defer_lock);
+	if (static_cast<const void*>(&in) < static_cast<const void*>(&out))
+	{
+		in_lock.lock();
+		out_lock.lock();
+	}
+	else
+	{
+		out_lock.lock();
+		in_lock.lock();
+	}
+	out.vec.resize(in.vec.size());
+	transform_parallel(in.vec.data(), in.vec.data() + in.vec.size(), out.vec.data(), op);
+}
+
+// index of the first element equal to val
+template<typename T, typename Value>
+std::optional<std::size_t> find_parallel(const Tvector<T>& v, Value val)
+{
+	return v.with_lock([&val](tvector_span<const T> s) -> std::optional<std::size_t>
+	{
+		const T* found = find_parallel(s.data(), s.data() + s.size(), val);
+		if (found == s.data() + s.size())
+			return std::nullopt;
+		return static_cast<std::size_t>(found - s.data());
+	});
+}
+
+// Moves elements in and out, so move-only T works. With a capacity
+// (0 = unbounded) a full queue blocks push/push_bulk until consumers make
+// room; try_push fails and push_for gives up after the timeout instead.
+// The *_bulk calls move up to a batch of elements per lock acquisition
+// and wake the other side once per batch.
 template<typename T>
 class threadsafe_queue
 {
 private:
 	mutable std::mutex mut;  //     
-	std::queue<T> data_queue;
+	std::deque<T> data_queue;
 	std::condition_variable data_cond;
+	std::condition_variable space_cond;
+	std::size_t max_size = 0;
+
+	bool full() const
+	{
+		return max_size && data_queue.size() >= max_size;
+	}
+	std::size_t room() const
+	{
+		return max_size ? max_size - std::min(max_size, data_queue.size()) : std::size_t(-1);
+	}
+	void notify(std::condition_variable& cond, std::size_t count)
+	{
+		if (count == 1)
+			cond.notify_one();
+		else if (count > 1)
+			cond.notify_all();
+	}
+	T take_front()
+	{
+		T value(std::move(data_queue.front()));
+		data_queue.pop_front();
+		if (max_size)
+			space_cond.notify_one();
+		return value;
+	}
+	template<typename OutputIt>
+	std::size_t take_front(OutputIt out, std::size_t max_count)
+	{
+		const std::size_t count = std::min(max_count, data_queue.size());
+		const auto last = data_queue.begin() + count;
+		std::move(data_queue.begin(), last, out);
+		data_queue.erase(data_queue.begin(), last);
+		if (max_size)
+			notify(space_cond, count);
+		return count;
+	}
+
 public:
 	threadsafe_queue()
 	{}
+	explicit threadsafe_queue(std::size_t capacity_) : max_size(capacity_)
+	{}
 	threadsafe_queue(threadsafe_queue const& other)
 	{
 		std::lock_guard<std::mutex> lk(other.mut);
 		data_queue = other.data_queue;
+		max_size = other.max_size;
 	}
 	void push(T new_value)
+	{
+		std::unique_lock<std::mutex> lk(mut);
+		space_cond.wait(lk, [this] {return !full(); });
+		data_queue.push_back(std::move(new_value));
+		data_cond.notify_one();
+	}
+	// new_value is only moved from when it went in
+	bool try_push(T&& new_value)
 	{
 		std::lock_guard<std::mutex> lk(mut);
-		data_queue.push(new_value);
+		if (full())
+			return false;
+		data_queue.push_back(std::move(new_value));
 		data_cond.notify_one();
+		return true;
+	}
+	bool try_push(const T& new_value)
+	{
+		T copy(new_value);
+		return try_push(std::move(copy));
+	}
+	template<typename Rep, typename Period>
+	bool push_for(T&& new_value, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		std::unique_lock<std::mutex> lk(mut);
+		if (!space_cond.wait_for(lk, timeout, [this] {return !full(); }))
+			return false;
+		data_queue.push_back(std::move(new_value));
+		data_cond.notify_one();
+		return true;
+	}
+	template<typename Rep, typename Period>
+	bool push_for(const T& new_value, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		T copy(new_value);
+		return push_for(std::move(copy), timeout);
+	}
+	// Pushes [first, last) in as few lock acquisitions as the capacity
+	// allows (one when unbounded); pass move iterators to move
+	template<typename Iterator>
+	void push_bulk(Iterator first, Iterator last)
+	{
+		std::unique_lock<std::mutex> lk(mut);
+		while (first != last)
+		{
+			space_cond.wait(lk, [this] {return !full(); });
+			std::size_t count = 0;
+			for (const std::size_t n = room(); count < n && first != last; ++count, ++first)
+				data_queue.push_back(*first);
+			notify(data_cond, count);
+		}
+	}
+	// moves the elements out of an rvalue range, copies from an lvalue one
+	template<typename Range>
+	void push_bulk(Range&& range)
+	{
+		if constexpr (std::is_lvalue_reference_v<Range>)
+			push_bulk(std::begin(range), std::end(range));
+		else
+			push_bulk(std::make_move_iterator(std::begin(range)), std::make_move_iterator(std::end(range)));
 	}
 	void wait_and_pop(T& value)
 	{
 		std::unique_lock<std::mutex> lk(mut);
 		data_cond.wait(lk, [this] {return !data_queue.empty(); });
-		value = data_queue.front();
-		data_queue.pop();
+		value = take_front();
 	}
 	std::shared_ptr<T> wait_and_pop()
 	{
 		std::unique_lock<std::mutex> lk(mut); 
 		data_cond.wait(lk, [this] {return !data_queue.empty(); });
-		std::shared_ptr<T> res(std::make_shared<T>(data_queue.front())); 
-		data_queue.pop();
-		return res;
+		return std::make_shared<T>(take_front());
+	}
+	// no allocation, unlike the shared_ptr form
+	T wait_and_pop_value()
+	{
+		std::unique_lock<std::mutex> lk(mut);
+		data_cond.wait(lk, [this] {return !data_queue.empty(); });
+		return take_front();
+	}
+	template<typename Rep, typename Period>
+	std::optional<T> wait_and_pop_for(const std::chrono::duration<Rep, Period>& timeout)
+	{
+		std::unique_lock<std::mutex> lk(mut);
+		if (!data_cond.wait_for(lk, timeout, [this] {return !data_queue.empty(); }))
+			return std::nullopt;
+		return take_front();
 	}
 	bool try_pop(T& value)
 	{
 		std::lock_guard<std::mutex> lk(mut);
 		if (data_queue.empty())
 			return false;
-		value = data_queue.front();
-		data_queue.pop();
+		value = take_front();
 
 		return true;
 	}
@@ -193,20 +470,67 @@ public:
 		std::lock_guard<std::mutex> lk(mut);
 		if (data_queue.empty())
 			return std::shared_ptr<T>();
-		std::shared_ptr<T> res(std::make_shared<T>(data_queue.front())); data_queue.pop();
-		return res;
+		return std::make_shared<T>(take_front());
+	}
+	std::optional<T> try_pop_value()
+	{
+		std::lock_guard<std::mutex> lk(mut);
+		if (data_queue.empty())
+			return std::nullopt;
+		return take_front();
+	}
+	// Move up to max_count elements to out; the count is returned.
+	// try_ never waits, wait_and_ waits for at least one element.
+	template<typename OutputIt>
+	std::size_t try_pop_bulk(OutputIt out, std::size_t max_count)
+	{
+		std::lock_guard<std::mutex> lk(mut);
+		return take_front(out, max_count);
+	}
+	template<typename OutputIt>
+	std::size_t wait_and_pop_bulk(OutputIt out, std::size_t max_count)
+	{
+		std::unique_lock<std::mutex> lk(mut);
+		data_cond.wait(lk, [this] {return !data_queue.empty(); });
+		return take_front(out, max_count);
+	}
+	// Takes everything in one swap; the elements are moved out after the
+	// lock is released
+	std::vector<T> drain()
+	{
+		std::deque<T> taken;
+		{
+			std::lock_guard<std::mutex> lk(mut);
+			taken.swap(data_queue);
+			if (max_size)
+				space_cond.notify_all();
+		}
+		return std::vector<T>(std::make_move_iterator(taken.begin()), std::make_move_iterator(taken.end()));
 	}
 	bool empty() const
 	{
 		std::lock_guard<std::mutex> lk(mut);
 		return data_queue.empty();
 	}
+	std::size_t size() const
+	{
+		std::lock_guard<std::mutex> lk(mut);
+		return data_queue.size();
+	}
+	// 0 when unbounded
+	std::size_t capacity() const
+	{
+		return max_size;
+	}
 };
 
 
 struct empty_stack : std::exception
 {
-	const char* what() const throw();
+	const char* what() const throw()
+	{
+		return "empty stack";
+	}
 };
 
 template<typename T>
@@ -0,0 +1,88 @@
+// async_bench.cpp : overlap of the async_* algorithms with work on the
+// calling thread. The caller starts a reduction over 150M doubles and keeps
+// serving small "requests" (a short loop each) until it is done, then a
+// coroutine combines a few async calls with when_all. Build with -std=c++20.
+// Argument: pool size.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cmath>
+
+#include "parallel_async.h"
+
+
+/// === helpers
+// stands in for one request of a service thread, about a microsecond
+double serve_request(std::size_t i)
+{
+    double x = static_cast<double>(i);
+    for (int k = 0; k < 200; ++k)
+        x = std::sqrt(x + k);
+    return x;
+}
+
+template<typename Func>
+double milliseconds(Func fun)
+{
+    const auto t1 = std::chrono::steady_clock::now();
+    fun();
+    const auto t2 = std::chrono::steady_clock::now();
+    const std::chrono::duration<double, std::milli> ms = t2 - t1;
+    return ms.count();
+}
+
+par_future<double> summary(const std::vector<double>& v, std::vector<double>& squares)
+{
+    auto [sum, range, squared] = co_await when_all(
+        async_accumulate(v.cbegin(), v.cend(), 0.0),
+        async_minmax_element(v.cbegin(), v.cend()),
+        async_transform(v.cbegin(), v.cend(), squares.begin(), [](double x) { return x * x; }));
+    const double sum_sq = co_await async_accumulate(squares.cbegin(), squares.cend(), 0.0);
+    const double mean = sum / v.size();
+    std::cout << "mean " << mean << ", min " << *range.first << ", max " << *range.second << '\n';
+    co_return std::sqrt(sum_sq / v.size() - mean * mean);
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        thread_pool::set_size(static_cast<unsigned>(std::stoul(argv[1])));
+    std::cout << "pool workers: " << thread_pool::instance().size() << " (+ calling thread)\n\n";
+
+    const size_t data_size = 150'000'007u;
+    std::vector<double> v(data_size);
+    std::vector<double> squares(data_size);
+    generate_random_parallel(v.begin(), v.end(), 0.0, 1.0);
+    accumulate_parallel(v.cbegin(), v.cend(), 0.0);    // tunes the grain size
+
+    double sum = 0;
+    const double blocking_ms = milliseconds([&] { sum = accumulate_parallel(v.cbegin(), v.cend(), 0.0); });
+
+    std::size_t served = 0;
+    double sink = 0;
+    double async_sum = 0;
+    const double async_ms = milliseconds([&] {
+        par_future<double> f = async_accumulate(v.cbegin(), v.cend(), 0.0);
+        while (!f.ready())
+            sink += serve_request(served++);
+        async_sum = f.get();
+    });
+
+    std::cout << std::fixed << std::setprecision(1)
+              << std::setw(34) << std::left << "accumulate_parallel" << blocking_ms << " ms, caller blocked\n"
+              << std::setw(34) << std::left << "async_accumulate" << async_ms << " ms, caller served "
+              << served << " requests\n" << std::defaultfloat << std::setprecision(6)
+              << (sum == async_sum ? "" : "sums differ\n") << (sink > 0 ? "" : "\n");
+
+    double stddev = 0;
+    const double summary_ms = milliseconds([&] { stddev = summary(v, squares).get(); });
+    std::cout << "stddev " << stddev << " (uniform: " << 1 / std::sqrt(12.0) << "), when_all pipeline "
+              << std::fixed << std::setprecision(1) << summary_ms << " ms\n";
+
+    return 0;
+}
@@ -0,0 +1,487 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <initializer_list>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "thread_pool.h"
+
+
+/// === bench_suite
+// Harness for the benchmark executables: every case runs warmup passes and
+// then a fixed number of timed repetitions, its result is checked, and the
+// median and percentiles go to a table on stdout and, with --out, to a CSV
+// or JSON file. A sweep over several thread counts restarts the executable
+// once per count, because the pool size is fixed when the pool starts.
+//
+//   --sizes=1M,16M       elements per case (K, M, G suffixes or 1e6 style)
+//   --threads=1,2,4      threads per run, calling thread included
+//   --types=int,double   element types (int, long, float, double)
+//   --reps=7 --warmup=1  timed repetitions and untimed passes per case
+//   --filter=sort,scan   only the groups whose name contains one of these
+//   --out=results.json   also write the records; .csv or .json picks the
+//   --format=csv|json    format unless --format is given
+//   --seed=N             seed of the generated data
+//
+// Within a group the case marked baseline (the std::execution::seq run)
+// is the reference of the speedup column.
+
+struct bench_options
+{
+    std::vector<std::size_t> sizes{ 1'000'000, 16'000'000 };
+    std::vector<unsigned> threads;
+    std::vector<std::string> types{ "int", "double" };
+    std::vector<std::string> filters;
+    unsigned reps = 7;
+    unsigned warmup = 1;
+    std::uint64_t seed = 42;
+    std::string out;
+    std::string format;
+    std::string raw;    // internal: where a child run of a sweep writes its records
+
+    // "150M" -> 150000000, "1e6" -> 1000000; less than 1 is an error, the
+    // benches divide by the size
+    static std::size_t parse_size(const std::string& text)
+    {
+        std::size_t pos = 0;
+        const double value = std::stod(text, &pos);
+        double scale = 1.0;
+        if (pos < text.size())
+        {
+            switch (text[pos])
+            {
+            case 'k': case 'K': scale = 1e3; break;
+            case 'm': case 'M': scale = 1e6; break;
+            case 'g': case 'G': scale = 1e9; break;
+            default: throw std::invalid_argument("bad size: " + text);
+            }
+        }
+        const long long size = std::llround(value * scale);
+        if (size < 1)
+            throw std::invalid_argument("size must be at least 1: " + text);
+        return static_cast<std::size_t>(size);
+    }
+
+    static std::vector<std::string> split(const std::string& list)
+    {
+        std::vector<std::string> res;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ','))
+            if (!item.empty())
+                res.push_back(item);
+        return res;
+    }
+
+    // Throws std::invalid_argument on an unknown option or a size of 0
+    bench_options(int argc, char* argv[])
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const std::size_t eq = arg.find('=');
+            const std::string key = arg.substr(0, eq);
+            const std::string value = (eq == std::string::npos) ? std::string() : arg.substr(eq + 1);
+            if (key == "--sizes")
+            {
+                sizes.clear();
+                for (const std::string& s : split(value))
+                    sizes.push_back(parse_size(s));
+            }
+            else if (key == "--threads")
+            {
+                threads.clear();
+                for (const std::string& s : split(value))
+                    threads.push_back(static_cast<unsigned>(std::max(1ul, std::stoul(s))));
+            }
+            else if (key == "--types")
+                types = split(value);
+            else if (key == "--filter")
+                filters = split(value);
+            else if (key == "--reps")
+                reps = static_cast<unsigned>(std::max(1ul, std::stoul(value)));
+            else if (key == "--warmup")
+                warmup = static_cast<unsigned>(std::stoul(value));
+            else if (key == "--seed")
+                seed = std::stoull(value);
+            else if (key == "--out")
+                out = value;
+            else if (key == "--format")
+                format = value;
+            else if (key == "--raw")
+                raw = value;
+            else
+                throw std::invalid_argument("unknown option: " + arg);
+        }
+        if (format.empty())
+            format = (out.size() > 4 && out.compare(out.size() - 4, 4, ".csv") == 0) ? "csv" : "json";
+        if (format != "csv" && format != "json")
+            throw std::invalid_argument("--format must be csv or json");
+    }
+
+    bool wants(const std::string& group) const
+    {
+        if (filters.empty())
+            return true;
+        return std::any_of(filters.begin(), filters.end(), [&group](const std::string& f) { return group.find(f) != std::string::npos; });
+    }
+
+    bool wants_any(std::initializer_list<const char*> groups) const
+    {
+        return std::any_of(groups.begin(), groups.end(), [this](const char* group) { return wants(group); });
+    }
+
+    bool wants_type(const std::string& type) const
+    {
+        return std::find(types.begin(), types.end(), type) != types.end();
+    }
+};
+
+
+/// === bench_record
+struct bench_stats
+{
+    double min_ms = 0, p10_ms = 0, median_ms = 0, p90_ms = 0, max_ms = 0, mean_ms = 0;
+};
+
+// Nearest-rank percentiles of the repetitions
+inline bench_stats make_stats(std::vector<double> ms)
+{
+    std::sort(ms.begin(), ms.end());
+    auto rank = [&ms](double q) { return ms[static_cast<std::size_t>(std::lround(q * (ms.size() - 1)))]; };
+    bench_stats s;
+    s.min_ms = ms.front();
+    s.p10_ms = rank(0.1);
+    s.median_ms = rank(0.5);
+    s.p90_ms = rank(0.9);
+    s.max_ms = ms.back();
+    double sum = 0;
+    for (double x : ms)
+        sum += x;
+    s.mean_ms = sum / ms.size();
+    return s;
+}
+
+struct bench_record
+{
+    std::string group;          // what is computed, e.g. "accumulate"
+    std::string name;           // how, e.g. "std::reduce (par)"
+    std::string type;
+    std::size_t size = 0;       // elements or operations
+    std::size_t bytes = 0;      // memory traffic of one repetition, 0 if not meaningful
+    bool baseline = false;
+    unsigned threads = 0;
+    unsigned reps = 0;
+    bench_stats stats;
+    bool ok = true;
+
+    double gbps() const
+    {
+        return bytes ? bytes / (stats.median_ms * 1e-3) / 1e9 : 0.0;
+    }
+
+    double mitems_per_s() const
+    {
+        return size / (stats.median_ms * 1e-3) / 1e6;
+    }
+};
+
+// Median of the baseline of the same group, type, size and thread count
+inline double baseline_ms(const std::vector<bench_record>& records, const bench_record& r)
+{
+    for (const bench_record& b : records)
+        if (b.baseline && b.group == r.group && b.type == r.type && b.size == r.size && b.threads == r.threads)
+            return b.stats.median_ms;
+    return 0.0;
+}
+
+
+/// === output
+inline void print_header()
+{
+    std::cout << std::left << std::setw(16) << "group" << std::setw(40) << "name" << std::setw(8) << "type"
+              << std::setw(12) << "size" << std::setw(5) << "thr" << std::right << std::setw(11) << "median ms"
+              << std::setw(11) << "p10 ms" << std::setw(11) << "p90 ms" << std::setw(9) << "GB/s"
+              << std::setw(9) << "x seq" << "  check\n";
+}
+
+inline void print_row(const bench_record& r, double base_ms)
+{
+    std::cout << std::left << std::setw(16) << r.group << std::setw(40) << r.name << std::setw(8) << r.type
+              << std::setw(12) << r.size << std::setw(5) << r.threads << std::right << std::fixed << std::setprecision(3)
+              << std::setw(11) << r.stats.median_ms << std::setw(11) << r.stats.p10_ms << std::setw(11) << r.stats.p90_ms
+              << std::setprecision(2) << std::setw(9) << r.gbps() << std::setw(9) << (base_ms > 0 ? base_ms / r.stats.median_ms : 0.0)
+              << std::defaultfloat << "  " << (r.ok ? "ok" : "MISMATCH") << std::endl;
+}
+
+inline const char* csv_header()
+{
+    return "group,name,type,size,bytes,baseline,threads,reps,min_ms,p10_ms,median_ms,p90_ms,max_ms,mean_ms,ok,gbps,mitems_per_s,speedup_vs_seq";
+}
+
+// Quotes a field holding a comma or a quote, doubling the quotes
+inline std::string csv_field(const std::string& s)
+{
+    if (s.find_first_of(",\"") == std::string::npos)
+        return s;
+    std::string res = "\"";
+    for (char c : s)
+    {
+        if (c == '"')
+            res += '"';
+        res += c;
+    }
+    return res + '"';
+}
+
+inline std::vector<std::string> split_csv_line(const std::string& line)
+{
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (std::size_t i = 0; i < line.size(); ++i)
+    {
+        const char c = line[i];
+        if (quoted && c == '"' && i + 1 < line.size() && line[i + 1] == '"')
+            fields.back() += line[++i];
+        else if (c == '"')
+            quoted = !quoted;
+        else if (c == ',' && !quoted)
+            fields.emplace_back();
+        else
+            fields.back() += c;
+    }
+    return fields;
+}
+
+inline void write_csv(std::ostream& out, const std::vector<bench_record>& records)
+{
+    out << csv_header() << '\n' << std::setprecision(9);
+    for (const bench_record& r : records)
+    {
+        const double base = baseline_ms(records, r);
+        out << csv_field(r.group) << ',' << csv_field(r.name) << ',' << csv_field(r.type) << ',' << r.size << ',' << r.bytes << ',' << r.baseline << ','
+            << r.threads << ',' << r.reps << ',' << r.stats.min_ms << ',' << r.stats.p10_ms << ',' << r.stats.median_ms << ','
+            << r.stats.p90_ms << ',' << r.stats.max_ms << ',' << r.stats.mean_ms << ',' << r.ok << ','
+            << r.gbps() << ',' << r.mitems_per_s() << ',' << (base > 0 ? base / r.stats.median_ms : 0.0) << '\n';
+    }
+}
+
+inline void write_json(std::ostream& out, const std::vector<bench_record>& records)
+{
+    auto quoted = [](const std::string& s)
+    {
+        std::string res = "\"";
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                res += '\\';
+            res += c;
+        }
+        return res + '"';
+    };
+    out << "[\n" << std::setprecision(9);
+    for (std::size_t i = 0; i < records.size(); ++i)
+    {
+        const bench_record& r = records[i];
+        const double base = baseline_ms(records, r);
+        out << "  {\"group\": " << quoted(r.group) << ", \"name\": " << quoted(r.name) << ", \"type\": " << quoted(r.type)
+            << ", \"size\": " << r.size << ", \"bytes\": " << r.bytes << ", \"baseline\": " << (r.baseline ? "true" : "false")
+            << ", \"threads\": " << r.threads << ", \"reps\": " << r.reps
+            << ", \"min_ms\": " << r.stats.min_ms << ", \"p10_ms\": " << r.stats.p10_ms << ", \"median_ms\": " << r.stats.median_ms
+            << ", \"p90_ms\": " << r.stats.p90_ms << ", \"max_ms\": " << r.stats.max_ms << ", \"mean_ms\": " << r.stats.mean_ms
+            << ", \"ok\": " << (r.ok ? "true" : "false") << ", \"gbps\": " << r.gbps() << ", \"mitems_per_s\": " << r.mitems_per_s()
+            << ", \"speedup_vs_seq\": ";
+        if (base > 0)
+            out << base / r.stats.median_ms;
+        else
+            out << "null";
+        out << '}' << (i + 1 < records.size() ? "," : "") << '\n';
+    }
+    out << "]\n";
+}
+
+// Reads back what write_csv wrote (the derived columns are recomputed)
+inline std::vector<bench_record> read_csv(std::istream& in)
+{
+    std::vector<bench_record> records;
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line))
+    {
+        const std::vector<std::string> f = split_csv_line(line);
+        if (f.size() < 15)
+            continue;
+        bench_record r;
+        r.group = f[0];
+        r.name = f[1];
+        r.type = f[2];
+        r.size = std::stoull(f[3]);
+        r.bytes = std::stoull(f[4]);
+        r.baseline = f[5] == "1";
+        r.threads = static_cast<unsigned>(std::stoul(f[6]));
+        r.reps = static_cast<unsigned>(std::stoul(f[7]));
+        r.stats = bench_stats{ std::stod(f[8]), std::stod(f[9]), std::stod(f[10]), std::stod(f[11]), std::stod(f[12]), std::stod(f[13]) };
+        r.ok = f[14] == "1";
+        records.push_back(r);
+    }
+    return records;
+}
+
+
+/// === bench_runner
+class bench_runner
+{
+private:
+    std::vector<bench_record> record_list;
+
+public:
+    const bench_options& options;
+
+    explicit bench_runner(const bench_options& options_) : options(options_)
+    {}
+
+    // setup() runs untimed before every pass (copies data for in-place
+    // algorithms), fun() is timed, check() looks at the last pass's result.
+    // The record names the case; threads, reps and stats are filled in.
+    template<typename Setup, typename Fun, typename Check>
+    void run(bench_record r, Setup setup, Fun fun, Check check)
+    {
+        if (!options.wants(r.group))
+            return;
+        for (unsigned i = 0; i < options.warmup; ++i)
+        {
+            setup();
+            fun();
+        }
+        std::vector<double> ms;
+        for (unsigned i = 0; i < options.reps; ++i)
+        {
+            setup();
+            const auto t1 = std::chrono::steady_clock::now();
+            fun();
+            const auto t2 = std::chrono::steady_clock::now();
+            ms.push_back(std::chrono::duration<double, std::milli>(t2 - t1).count());
+        }
+        r.ok = check();
+        r.threads = static_cast<unsigned>(thread_pool::instance().size() + 1);
+        r.reps = options.reps;
+        r.stats = make_stats(std::move(ms));
+        record_list.push_back(r);
+        print_row(r, baseline_ms(record_list, r));
+    }
+
+    template<typename Fun, typename Check>
+    void run(bench_record r, Fun fun, Check check)
+    {
+        run(std::move(r), [] {}, fun, check);
+    }
+
+    const std::vector<bench_record>& records() const
+    {
+        return record_list;
+    }
+};
+
+
+/// === run_bench_suite
+// One word for /bin/sh: in single quotes, each ' closed, escaped and reopened
+inline std::string shell_quote(const std::string& word)
+{
+    std::string res = "'";
+    for (char c : word)
+    {
+        if (c == '\'')
+            res += "'\\''";
+        else
+            res += c;
+    }
+    return res + '\'';
+}
+
+// cases(bench_runner&) registers and runs everything; returns the exit
+// code of main: 0, 1 if a check failed, 2 on bad options
+template<typename Cases>
+int run_bench_suite(int argc, char* argv[], Cases cases)
+{
+    try
+    {
+        const bench_options options(argc, argv);
+        std::vector<bench_record> records;
+
+        if (options.threads.size() > 1 && options.raw.empty())
+        {
+            // one child per thread count, each appends its CSV to a raw file
+            std::string forwarded;
+            for (int i = 1; i < argc; ++i)
+            {
+                const std::string arg = argv[i];
+                if (arg.rfind("--threads", 0) != 0 && arg.rfind("--out", 0) != 0 && arg.rfind("--format", 0) != 0)
+                    forwarded += ' ' + shell_quote(arg);
+            }
+            for (unsigned threads : options.threads)
+            {
+                const std::string raw = (options.out.empty() ? std::string("bench") : options.out) + ".threads" + std::to_string(threads) + ".raw.csv";
+                const std::string command = shell_quote(argv[0]) + forwarded
+                    + " --threads=" + std::to_string(threads) + ' ' + shell_quote("--raw=" + raw);
+                std::cout << "=== " << threads << " threads" << std::endl;
+                if (std::system(command.c_str()) != 0)
+                    std::cout << "run with " << threads << " threads reported an error\n";
+                std::ifstream in(raw);
+                const std::vector<bench_record> part = read_csv(in);
+                records.insert(records.end(), part.begin(), part.end());
+                in.close();
+                std::remove(raw.c_str());
+            }
+        }
+        else
+        {
+            if (!options.threads.empty())
+                thread_pool::set_size(options.threads.front() - 1);
+            std::cout << "threads: " << thread_pool::instance().size() + 1 << " (pool workers + calling thread)\n";
+            print_header();
+            bench_runner runner(options);
+            cases(runner);
+            records = runner.records();
+
+            if (!options.raw.empty())
+            {
+                std::ofstream raw(options.raw);
+                write_csv(raw, records);
+                return 0;
+            }
+        }
+
+        if (!options.out.empty())
+        {
+            std::ofstream out(options.out);
+            if (options.format == "csv")
+                write_csv(out, records);
+            else
+                write_json(out, records);
+            if (!out)
+                std::cout << "could not write " << options.out << '\n';
+        }
+        const bool all_ok = std::all_of(records.begin(), records.end(), [](const bench_record& r) { return r.ok; });
+        return all_ok ? 0 : 1;
+    }
+    catch (const std::logic_error& e)
+    {
+        // std::invalid_argument, and std::out_of_range from stod/stoul
+        std::cerr << e.what() << '\n';
+        return 2;
+    }
+}
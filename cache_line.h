@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstddef>
+
+// std::hardware_destructive_interference_size is missing or unstable
+// across compilers, 64 bytes covers x86-64 and most ARM cores
+inline constexpr std::size_t cache_line_size = 64;
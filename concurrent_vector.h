@@ -0,0 +1,194 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if !defined(__cpp_lib_int_pow2)
+#error "concurrent_vector.h needs C++20 <bit>"
+#endif
+
+
+/// === concurrent_vector
+// Grows by whole segments that never move: segment 0 holds the first
+// first_segment_size elements and every following segment doubles the
+// capacity, so index i lives in segment bit_width(i + first) - 1 - log2(first).
+// push_back/grow_by claim their indices with one fetch_add and return them;
+// element access is two loads and takes no lock. An element may be read once
+// the push_back that returned its index has completed.
+// Nothing may throw between the claim and the end of the construction, as
+// size() and clear() count the index from then on: a constructor that may
+// throw runs on a temporary before the claim, which is then moved in (T's
+// move constructor must not throw), and grow_by needs a constructor that
+// cannot throw. Running out of memory for a new segment there terminates.
+template<typename T>
+class concurrent_vector
+{
+private:
+    static constexpr std::size_t first_segment_log = 4;
+    static constexpr std::size_t first_segment_size = std::size_t(1) << first_segment_log;
+    static constexpr std::size_t max_segments = sizeof(std::size_t) * 8 - first_segment_log;
+
+    std::atomic<T*> segments[max_segments];
+    std::atomic<std::size_t> my_size;
+
+    static std::size_t segment_of(std::size_t index)
+    {
+        return std::bit_width(index + first_segment_size) - 1 - first_segment_log;
+    }
+
+    static std::size_t segment_base(std::size_t segment)
+    {
+        return (first_segment_size << segment) - first_segment_size;
+    }
+
+    static std::size_t segment_size(std::size_t segment)
+    {
+        return first_segment_size << segment;
+    }
+
+    static T* allocate(std::size_t segment)
+    {
+        return static_cast<T*>(::operator new(sizeof(T) * segment_size(segment), std::align_val_t(alignof(T))));
+    }
+
+    static void deallocate(T* p)
+    {
+        ::operator delete(p, std::align_val_t(alignof(T)));
+    }
+
+    // Several threads may race to allocate the same segment; one wins the CAS
+    T* get_segment(std::size_t segment)
+    {
+        T* seg = segments[segment].load(std::memory_order_acquire);
+        if (seg)
+            return seg;
+        T* fresh = allocate(segment);
+        if (segments[segment].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+            return fresh;
+        deallocate(fresh);
+        return seg;
+    }
+
+    T* slot(std::size_t index)
+    {
+        const std::size_t segment = segment_of(index);
+        return get_segment(segment) + (index - segment_base(segment));
+    }
+
+    template<typename... Args>
+    std::size_t append(Args&&... args) noexcept
+    {
+        const std::size_t index = my_size.fetch_add(1);
+        ::new (static_cast<void*>(slot(index))) T(std::forward<Args>(args)...);
+        return index;
+    }
+
+    template<typename... Args>
+    std::size_t grow(std::size_t n, const Args&... args) noexcept
+    {
+        static_assert(std::is_nothrow_constructible_v<T, const Args&...>, "concurrent_vector::grow_by needs a constructor that does not throw");
+        const std::size_t first = my_size.fetch_add(n);
+        for (std::size_t i = first; i < first + n; ++i)
+            ::new (static_cast<void*>(slot(i))) T(args...);
+        return first;
+    }
+
+public:
+    concurrent_vector() : my_size(0)
+    {
+        for (std::atomic<T*>& seg : segments)
+            seg.store(nullptr, std::memory_order_relaxed);
+    }
+
+    concurrent_vector(const concurrent_vector&) = delete;
+    concurrent_vector& operator=(const concurrent_vector&) = delete;
+
+    ~concurrent_vector()
+    {
+        clear();
+        for (std::atomic<T*>& seg : segments)
+        {
+            T* p = seg.load();
+            if (p)
+                deallocate(p);
+        }
+    }
+
+    std::size_t push_back(const T& value)
+    {
+        return emplace_back(value);
+    }
+
+    std::size_t push_back(T&& value)
+    {
+        return emplace_back(std::move(value));
+    }
+
+    template<typename... Args>
+    std::size_t emplace_back(Args&&... args)
+    {
+        if constexpr (std::is_nothrow_constructible_v<T, Args&&...>)
+            return append(std::forward<Args>(args)...);
+        else
+        {
+            static_assert(std::is_nothrow_move_constructible_v<T>, "concurrent_vector needs T's move constructor not to throw");
+            T value(std::forward<Args>(args)...);
+            return append(std::move(value));
+        }
+    }
+
+    // Appends n value-initialized elements, returns the index of the first one
+    std::size_t grow_by(std::size_t n)
+    {
+        return grow(n);
+    }
+
+    std::size_t grow_by(std::size_t n, const T& value)
+    {
+        return grow(n, value);
+    }
+
+    // Allocates the segments up to capacity n in advance
+    void reserve(std::size_t n)
+    {
+        if (n == 0)
+            return;
+        for (std::size_t segment = 0; segment <= segment_of(n - 1); ++segment)
+            get_segment(segment);
+    }
+
+    T& operator[](std::size_t index)
+    {
+        const std::size_t segment = segment_of(index);
+        return segments[segment].load(std::memory_order_acquire)[index - segment_base(segment)];
+    }
+
+    const T& operator[](std::size_t index) const
+    {
+        const std::size_t segment = segment_of(index);
+        return segments[segment].load(std::memory_order_acquire)[index - segment_base(segment)];
+    }
+
+    // Number of claimed indices, including elements still being constructed
+    std::size_t size() const
+    {
+        return my_size.load();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    // Not thread-safe: keeps the segments, destroys the elements
+    void clear()
+    {
+        const std::size_t n = my_size.exchange(0);
+        for (std::size_t i = 0; i < n; ++i)
+            (*this)[i].~T();
+    }
+};
@@ -0,0 +1,138 @@
+// concurrent_vector_bench.cpp : producers appending to one vector,
+// concurrent_vector::push_back against std::vector::push_back under a
+// mutex, then a read of every element to check that none was lost. Also
+// appends a type whose copy constructor throws now and then, which must
+// leave size() counting only the elements that exist. Build with
+// -std=c++20. Arguments: millions of items per run (default 4).
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+
+#include "concurrent_vector.h"
+
+
+/// === helpers
+struct append_result
+{
+    double items_per_sec;
+    bool ok;
+};
+
+// every producer appends per_thread values t * per_thread + i
+template<typename Append, typename Sum>
+append_result run_producers(unsigned threads, std::size_t items, Append append, Sum sum)
+{
+    const std::size_t per_thread = items / threads;
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            while (!go.load())
+                std::this_thread::yield();
+            const std::uint64_t base = static_cast<std::uint64_t>(t) * per_thread;
+            for (std::size_t i = 0; i < per_thread; ++i)
+                append(base + i);
+        });
+    }
+
+    const auto t1 = std::chrono::steady_clock::now();
+    go.store(true);
+    for (std::thread& th : workers)
+        th.join();
+    const auto t2 = std::chrono::steady_clock::now();
+
+    const std::uint64_t n = static_cast<std::uint64_t>(per_thread) * threads;
+    const std::chrono::duration<double> sec = t2 - t1;
+    return { n / sec.count(), sum() == n * (n - 1) / 2 };
+}
+
+struct throws_on_copy
+{
+    int value;
+
+    explicit throws_on_copy(int v) : value(v) {}
+    throws_on_copy(throws_on_copy&&) noexcept = default;
+    throws_on_copy(const throws_on_copy& other) : value(other.value)
+    {
+        if (value % 7 == 0)
+            throw std::runtime_error("copy");
+    }
+};
+
+// size() after 1000 copies, every seventh of which throws, against the
+// number that succeeded; each element must hold what was copied
+bool check_throwing_copy()
+{
+    concurrent_vector<throws_on_copy> v;
+    std::size_t appended = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        const throws_on_copy item(i);
+        try
+        {
+            v.push_back(item);
+            ++appended;
+        }
+        catch (const std::runtime_error&)
+        {}
+    }
+    if (v.size() != appended)
+        return false;
+    for (std::size_t i = 0; i < v.size(); ++i)
+        if (v[i].value % 7 == 0)
+            return false;
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const std::size_t items = (argc > 1 ? std::stoul(argv[1]) : 4) * 1'000'000;
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", items: " << items << "\n\n";
+
+    std::cout << std::setw(10) << std::left << "threads" << std::setw(26) << "vector + mutex Mitems/s"
+              << std::setw(28) << "concurrent_vector Mitems/s" << "speedup\n";
+    for (unsigned threads : { 1, 2, 4, 8, 16 })
+    {
+        std::mutex mut;
+        std::vector<std::uint64_t> locked;
+        const append_result old_rate = run_producers(threads, items, [&](std::uint64_t value) {
+            std::lock_guard<std::mutex> lk(mut);
+            locked.push_back(value);
+        }, [&] {
+            std::uint64_t s = 0;
+            for (std::uint64_t x : locked)
+                s += x;
+            return s;
+        });
+
+        concurrent_vector<std::uint64_t> shared;
+        const append_result new_rate = run_producers(threads, items, [&](std::uint64_t value) {
+            shared.push_back(value);
+        }, [&] {
+            std::uint64_t s = 0;
+            for (std::size_t i = 0; i < shared.size(); ++i)
+                s += shared[i];
+            return s;
+        });
+
+        std::cout << std::fixed << std::setprecision(2) << std::setw(10) << threads
+                  << std::setw(26) << old_rate.items_per_sec / 1e6 << std::setw(28) << new_rate.items_per_sec / 1e6
+                  << new_rate.items_per_sec / old_rate.items_per_sec << 'x' << std::defaultfloat
+                  << (old_rate.ok && new_rate.ok ? "" : "  (lost items)") << '\n';
+    }
+
+    std::cout << "\nthrowing copy constructor: " << (check_throwing_copy() ? "size() matches" : "FAILED") << '\n';
+    return 0;
+}
@@ -0,0 +1,135 @@
+// game_bench.cpp : matches/s of match_engine for 10K .. 10M concurrent
+// matches of the thread_game rules on the shared pool, against one kernel
+// thread per player (turns passed with token_ring, no output) for 100 and
+// 1000 concurrent matches.
+// Arguments: pool size, then players per match (default 3).
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <string>
+#include <memory>
+#include <system_error>
+
+#include "game_engine.h"
+#include "token_ring.h"
+
+
+/// === helpers
+template<typename Func>
+double seconds(Func fun)
+{
+    const auto t1 = std::chrono::steady_clock::now();
+    fun();
+    const auto t2 = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> sec = t2 - t1;
+    return sec.count();
+}
+
+// the thread_game way, every player on its own thread
+double thread_per_player(std::size_t matches, unsigned players)
+{
+    struct match
+    {
+        token_ring ring;
+        int quantity = 25;
+        std::uint64_t rng;
+        match(unsigned players, std::uint64_t seed) : ring(players, 0), rng(seed) {}
+    };
+    std::vector<std::unique_ptr<match>> games;
+    for (std::size_t m = 0; m < matches; ++m)
+        games.push_back(std::make_unique<match>(players, m + 1));
+
+    std::vector<std::thread> threads;
+    threads.reserve(matches * players);
+    try
+    {
+        for (std::size_t m = 0; m < matches; ++m)
+            for (unsigned p = 0; p < players; ++p)
+                threads.emplace_back([&game = *games[m], p] {
+                    while (game.ring.wait_turn(p))
+                    {
+                        if (game.quantity == 1)
+                        {
+                            game.ring.stop();
+                            return;
+                        }
+                        game.rng = game.rng * 6364136223846793005ull + 1442695040888963407ull;
+                        const int hi = (game.quantity <= 10) ? game.quantity / 2 : 10;
+                        game.quantity -= 1 + static_cast<int>(((game.rng >> 32) * hi) >> 32);
+                        game.ring.pass(p);
+                    }
+                });
+    }
+    catch (...)
+    {
+        // out of threads: end the matches that have started
+        for (std::unique_ptr<match>& game : games)
+            game->ring.stop();
+        for (std::thread& th : threads)
+            th.join();
+        throw;
+    }
+    return seconds([&] {
+        for (std::unique_ptr<match>& game : games)
+            game->ring.start();
+        for (std::thread& th : threads)
+            th.join();
+    });
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        thread_pool::set_size(static_cast<unsigned>(std::stoul(argv[1])));
+    const unsigned long players_arg = argc > 2 ? std::stoul(argv[2]) : 3;
+    if (players_arg < 1 || players_arg > 127)
+    {
+        std::cerr << "players per match must be 1 .. 127\n";
+        return 1;
+    }
+    const unsigned players = static_cast<unsigned>(players_arg);
+    std::cout << "pool workers: " << thread_pool::instance().size() << " (+ calling thread), "
+              << players << " players per match\n\n";
+
+    std::cout << std::setw(22) << std::left << "engine" << std::setw(12) << "matches" << std::setw(14) << "ms"
+              << std::setw(16) << "matches/s" << std::setw(14) << "moves/match" << "losses by seat\n";
+    for (std::size_t matches : { 10'000, 100'000, 1'000'000, 10'000'000 })
+    {
+        match_engine engine(matches, players);
+        std::uint64_t moves = 0;
+        const double sec = seconds([&] { moves = engine.run(); });
+        std::vector<std::size_t> losses(players);
+        for (std::size_t m = 0; m < matches; ++m)
+            ++losses[engine.loser(m)];
+        std::cout << std::setw(22) << "match_engine" << std::setw(12) << matches << std::fixed << std::setprecision(1)
+                  << std::setw(14) << sec * 1000 << std::setw(16) << std::setprecision(0) << matches / sec
+                  << std::setw(14) << std::setprecision(2) << double(moves) / matches << std::defaultfloat;
+        for (std::size_t l : losses)
+            std::cout << l << ' ';
+        std::cout << '\n';
+    }
+
+    for (std::size_t matches : { 100, 1'000 })
+    {
+        double sec = 0;
+        try
+        {
+            sec = thread_per_player(matches, players);
+        }
+        catch (const std::system_error& e)
+        {
+            std::cout << std::setw(22) << "thread per player" << std::setw(12) << matches << "no threads: " << e.what() << '\n';
+            continue;
+        }
+        std::cout << std::setw(22) << "thread per player" << std::setw(12) << matches << std::fixed << std::setprecision(1)
+                  << std::setw(14) << sec * 1000 << std::setw(16) << std::setprecision(0) << matches / sec
+                  << std::defaultfloat << '\n';
+    }
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel_alghr.h"
+
+
+/// === match_engine
+// Plays many matches of the thread_game rules at once on the shared pool
+// instead of one kernel thread per player: every match starts with
+// start_quantity, the player whose turn it is takes 1 .. 10 (at most half
+// of what is left once 10 or less remain) and the one facing a single
+// item loses. A player is no more than the turn index of its match, so a
+// move is a few loads and stores.
+// The state lives in one array per field (structure of arrays), indexed
+// by match. run() splits the matches into blocks with split_reduce; a
+// block plays them in rounds, one move of every unfinished match per
+// round, dropping finished matches from its active list, so all matches
+// of a block progress together and a block never waits on anything.
+// Every match draws from its own generator, seeded from seed and its
+// index, so the results do not depend on the number of threads.
+// 1 .. 127 players per match, a start_quantity of at least 1 and up to
+// 2^32 matches; the constructor throws std::invalid_argument otherwise.
+class match_engine
+{
+private:
+    std::size_t count;
+    unsigned players;
+    int start_quantity;
+    std::vector<int> quantity;
+    std::vector<std::uint8_t> turn;
+    std::vector<std::int8_t> loser_seat;    // -1 while the match runs
+    std::vector<std::uint32_t> move_count;
+    std::vector<std::uint64_t> rng;
+
+    static std::uint64_t splitmix64(std::uint64_t& state)
+    {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [1, hi]
+    static int draw(std::uint64_t& state, int hi)
+    {
+        const std::uint64_t r = splitmix64(state) >> 32;
+        return 1 + static_cast<int>((r * static_cast<std::uint64_t>(hi)) >> 32);
+    }
+
+    // before any of the arrays is allocated
+    static std::size_t checked_count(std::size_t matches, unsigned players_per_match, int start_quantity_)
+    {
+        if (players_per_match < 1 || players_per_match > 127)
+            throw std::invalid_argument("match_engine: players_per_match must be 1 .. 127");
+        if (start_quantity_ < 1)
+            throw std::invalid_argument("match_engine: start_quantity must be at least 1");
+        if (static_cast<std::uint64_t>(matches) > (std::uint64_t(1) << 32))
+            throw std::invalid_argument("match_engine: more than 2^32 matches");
+        return matches;
+    }
+
+    // one move of match i; false once it is over
+    bool play_move(std::size_t i)
+    {
+        int& q = quantity[i];
+        ++move_count[i];
+        if (q == 1)
+        {
+            loser_seat[i] = static_cast<std::int8_t>(turn[i]);
+            return false;
+        }
+        q -= draw(rng[i], (q <= 10) ? q / 2 : 10);
+        turn[i] = static_cast<std::uint8_t>(turn[i] + 1u == players ? 0 : turn[i] + 1);
+        return true;
+    }
+
+    // plays the matches [offset, offset + n) to the end; returns their moves
+    std::uint64_t play_block(std::size_t offset, std::size_t n)
+    {
+        std::vector<std::uint32_t> active;
+        active.reserve(n);
+        for (std::size_t i = offset; i < offset + n; ++i)
+            if (loser_seat[i] < 0)
+                active.push_back(static_cast<std::uint32_t>(i));
+        std::uint64_t moves = 0;
+        while (!active.empty())
+        {
+            std::size_t still = 0;
+            for (std::uint32_t i : active)
+                if (play_move(i))
+                    active[still++] = i;
+            moves += active.size();
+            active.resize(still);
+        }
+        return moves;
+    }
+
+public:
+    match_engine(std::size_t matches, unsigned players_per_match = 3, int start_quantity_ = 25, std::uint64_t seed = 0)
+        : count(checked_count(matches, players_per_match, start_quantity_)), players(players_per_match), start_quantity(start_quantity_),
+          quantity(matches), turn(matches), loser_seat(matches), move_count(matches), rng(matches)
+    {
+        reset(seed);
+    }
+
+    // all matches back to the first move, with new generators
+    void reset(std::uint64_t seed)
+    {
+        std::uint64_t state = seed;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            quantity[i] = start_quantity;
+            turn[i] = 0;
+            loser_seat[i] = -1;
+            move_count[i] = 0;
+            rng[i] = splitmix64(state);
+        }
+    }
+
+    // plays every unfinished match to the end; returns the moves made
+    std::uint64_t run()
+    {
+        if (!count)
+            return 0;
+        return split_reduce(quantity.data(), count, split_grain(count, 1024),
+            [this](int* block_first, int* block_last, std::size_t offset) { return play_block(offset, block_last - block_first); },
+            [](std::uint64_t left, std::uint64_t right) { return left + right; });
+    }
+
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    unsigned players_per_match() const
+    {
+        return players;
+    }
+
+    // seat 0 .. players_per_match() - 1 of the loser, -1 while running
+    int loser(std::size_t match) const
+    {
+        return loser_seat[match];
+    }
+
+    std::size_t moves(std::size_t match) const
+    {
+        return move_count[match];
+    }
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+#include "thread_pool.h"
+
+
+/// === grain_tuner
+// Cost per element (ns) of each block function the *_parallel algorithms
+// split, measured on its first call instead of a hardcoded min_per_thread.
+// The key is the algorithm name plus the mangled type of its block lambda,
+// which carries the iterator, element and functor types: functors of
+// distinct types (every lambda has its own) are tuned separately, but all
+// functions passed as the same pointer type, say double(*)(double), share
+// one key and the cost measured first. Wrap such a function in a lambda to
+// give it a cost of its own.
+//
+// A block is made at least block_tasks times as expensive as handing a task
+// to the pool, so the split overhead stays in the percent range; ranges
+// shorter than that run serially on the calling thread.
+//
+// The costs can be saved to and loaded from a text file (one "key<TAB>ns"
+// per line). If PARALLEL_GRAIN_CACHE names a file, it is loaded on first
+// use and written back at exit. Keys hold mangled lambda types, so a file
+// only fits the binary that wrote it; unknown keys are simply never used.
+class grain_tuner
+{
+private:
+    mutable std::mutex mut;
+    std::unordered_map<std::string, double> costs;
+    std::once_flag task_once;
+    double task_cost = 0.0;
+    std::string cache_path;
+
+    grain_tuner()
+    {
+        if (const char* path = std::getenv("PARALLEL_GRAIN_CACHE"))
+        {
+            cache_path = path;
+            load(cache_path);
+        }
+    }
+
+    // Best of a few batches of submit + get of an empty task
+    static double measure_task_ns()
+    {
+        thread_pool& pool = thread_pool::instance();
+        const int batches = 4;
+        const int rounds = 64;
+        double best = std::numeric_limits<double>::max();
+        for (int b = 0; b < batches; ++b)
+        {
+            const auto t1 = std::chrono::steady_clock::now();
+            for (int r = 0; r < rounds; ++r)
+            {
+                auto f = pool.submit([] {});
+                pool.get(f);
+            }
+            const auto t2 = std::chrono::steady_clock::now();
+            const std::chrono::duration<double, std::nano> ns = t2 - t1;
+            best = std::min(best, ns.count() / rounds);
+        }
+        return best;
+    }
+
+public:
+    static constexpr double block_tasks = 16.0;
+    // The first call of a key runs serially on growing pieces until this
+    // much time has passed, then records the cost and splits the rest
+    static constexpr double probe_ns = 50'000.0;
+    // Shorter probes are mostly timer noise and are not recorded
+    static constexpr double min_probe_ns = 5'000.0;
+    static constexpr std::size_t probe_first_piece = 256;
+
+    grain_tuner(const grain_tuner&) = delete;
+    grain_tuner& operator=(const grain_tuner&) = delete;
+
+    ~grain_tuner()
+    {
+        if (!cache_path.empty())
+            save(cache_path);
+    }
+
+    static grain_tuner& instance()
+    {
+        static grain_tuner tuner;
+        return tuner;
+    }
+
+    template<typename Block>
+    static std::string key(const char* algorithm)
+    {
+        return std::string(algorithm) + ' ' + typeid(Block).name();
+    }
+
+    std::optional<double> cost(const std::string& key) const
+    {
+        std::lock_guard<std::mutex> lk(mut);
+        const auto it = costs.find(key);
+        if (it == costs.end())
+            return std::nullopt;
+        return it->second;
+    }
+
+    void record(const std::string& key, double ns_per_element)
+    {
+        std::lock_guard<std::mutex> lk(mut);
+        costs[key] = ns_per_element;
+    }
+
+    // Forgets all costs, the next call of every algorithm measures again
+    void clear()
+    {
+        std::lock_guard<std::mutex> lk(mut);
+        costs.clear();
+    }
+
+    // ns to submit a task to the shared pool and get it back, measured once
+    double task_ns()
+    {
+        std::call_once(task_once, [this] { task_cost = measure_task_ns(); });
+        return task_cost;
+    }
+
+    // Smallest block worth a task for elements costing ns_per_element
+    std::size_t min_grain(double ns_per_element)
+    {
+        const double elements = block_tasks * task_ns() / std::max(ns_per_element, 1e-3);
+        if (elements >= static_cast<double>(std::numeric_limits<std::size_t>::max() / 2))
+            return std::numeric_limits<std::size_t>::max() / 2;
+        return std::max<std::size_t>(1, static_cast<std::size_t>(elements));
+    }
+
+    // Returns false if the file can't be read; malformed lines are skipped
+    bool load(const std::string& path)
+    {
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::string line;
+        std::lock_guard<std::mutex> lk(mut);
+        while (std::getline(in, line))
+        {
+            const std::size_t tab = line.rfind('\t');
+            if (tab == std::string::npos)
+                continue;
+            char* end = nullptr;
+            const double ns = std::strtod(line.c_str() + tab + 1, &end);
+            if (end != line.c_str() + tab + 1 && ns > 0.0)
+                costs[line.substr(0, tab)] = ns;
+        }
+        return true;
+    }
+
+    bool save(const std::string& path) const
+    {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out.precision(17);
+        std::lock_guard<std::mutex> lk(mut);
+        for (const auto& entry : costs)
+            out << entry.first << '\t' << entry.second << '\n';
+        return static_cast<bool>(out);
+    }
+};
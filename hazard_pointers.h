@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+/// === hazard pointers
+// A thread publishes the node it is about to dereference in its hazard
+// pointer; retired nodes are only deleted once no hazard pointer refers to
+// them. Besides safe reclamation this also rules out ABA on the protected
+// node: its address cannot be reused while somebody may still compare it.
+unsigned const max_hazard_pointers = 128;
+
+struct hazard_pointer
+{
+    std::atomic<std::thread::id> id;
+    std::atomic<void*> pointer;
+};
+
+inline hazard_pointer hazard_pointers[max_hazard_pointers];
+
+class hp_owner
+{
+private:
+    hazard_pointer* hp;
+
+public:
+    hp_owner() : hp(nullptr)
+    {
+        for (unsigned i = 0; i < max_hazard_pointers; ++i)
+        {
+            std::thread::id old_id;
+            if (hazard_pointers[i].id.compare_exchange_strong(old_id, std::this_thread::get_id()))
+            {
+                hp = &hazard_pointers[i];
+                break;
+            }
+        }
+        if (!hp)
+            throw std::runtime_error("No hazard pointers available");
+    }
+
+    hp_owner(const hp_owner&) = delete;
+    hp_owner& operator=(const hp_owner&) = delete;
+
+    std::atomic<void*>& get_pointer()
+    {
+        return hp->pointer;
+    }
+
+    ~hp_owner()
+    {
+        hp->pointer.store(nullptr);
+        hp->id.store(std::thread::id());
+    }
+};
+
+inline std::atomic<void*>& get_hazard_pointer_for_current_thread()
+{
+    thread_local static hp_owner hazard;
+    return hazard.get_pointer();
+}
+
+
+/// === deferred reclamation
+struct retired_node
+{
+    void* pointer;
+    void (*deleter)(void*);
+};
+
+// Nodes left behind by threads that exited while the nodes were still
+// protected; the next scan of any thread picks them up
+struct retired_orphans
+{
+    std::mutex mut;
+    std::vector<retired_node> nodes;
+
+    ~retired_orphans()
+    {
+        // static destruction: no thread can hold a hazard pointer any more
+        for (retired_node& node : nodes)
+            node.deleter(node.pointer);
+    }
+};
+
+inline retired_orphans& get_retired_orphans()
+{
+    static retired_orphans orphans;
+    return orphans;
+}
+
+// Per-thread list, scanned in batches so one scan of the hazard pointer
+// array pays for many deletions
+class retire_list
+{
+private:
+    std::vector<retired_node> nodes;
+
+public:
+    static std::size_t const scan_threshold = 2 * max_hazard_pointers;
+
+    void add(retired_node node)
+    {
+        nodes.push_back(node);
+        if (nodes.size() >= scan_threshold)
+            scan();
+    }
+
+    void scan()
+    {
+        {
+            retired_orphans& orphans = get_retired_orphans();
+            std::lock_guard<std::mutex> lock(orphans.mut);
+            nodes.insert(nodes.end(), orphans.nodes.begin(), orphans.nodes.end());
+            orphans.nodes.clear();
+        }
+
+        std::vector<void*> hazards;
+        hazards.reserve(max_hazard_pointers);
+        for (unsigned i = 0; i < max_hazard_pointers; ++i)
+        {
+            void* const p = hazard_pointers[i].pointer.load();
+            if (p)
+                hazards.push_back(p);
+        }
+        std::sort(hazards.begin(), hazards.end());
+
+        auto still_protected = std::partition(nodes.begin(), nodes.end(), [&hazards](const retired_node& node) {
+            return std::binary_search(hazards.begin(), hazards.end(), node.pointer);
+        });
+        for (auto it = still_protected; it != nodes.end(); ++it)
+            it->deleter(it->pointer);
+        nodes.erase(still_protected, nodes.end());
+    }
+
+    ~retire_list()
+    {
+        scan();
+        if (nodes.empty())
+            return;
+        retired_orphans& orphans = get_retired_orphans();
+        std::lock_guard<std::mutex> lock(orphans.mut);
+        orphans.nodes.insert(orphans.nodes.end(), nodes.begin(), nodes.end());
+    }
+};
+
+template<typename T>
+void do_delete(void* p)
+{
+    delete static_cast<T*>(p);
+}
+
+inline retire_list& get_retire_list_for_current_thread()
+{
+    thread_local static retire_list retired;
+    return retired;
+}
+
+// Deletes node as soon as no hazard pointer protects it
+template<typename T>
+void reclaim_later(T* node)
+{
+    get_retire_list_for_current_thread().add(retired_node{ node, &do_delete<T> });
+}
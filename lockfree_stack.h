@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+#include "hazard_pointers.h"
+
+
+/// === lockfree_stack
+// Treiber stack: push and pop are a single CAS on head. A popping thread
+// protects head with its hazard pointer before reading head->next, so the
+// node can neither be freed nor reused (ABA) under it.
+template<typename T>
+class lockfree_stack
+{
+private:
+    struct node
+    {
+        T data;
+        node* next;
+
+        node(T data_) : data(std::move(data_)), next(nullptr)
+        {}
+    };
+
+    std::atomic<node*> head;
+
+public:
+    lockfree_stack() : head(nullptr)
+    {}
+
+    lockfree_stack(const lockfree_stack&) = delete;
+    lockfree_stack& operator=(const lockfree_stack&) = delete;
+
+    ~lockfree_stack()
+    {
+        node* current = head.load();
+        while (current)
+        {
+            node* const next = current->next;
+            delete current;
+            current = next;
+        }
+    }
+
+    void push(T new_value)
+    {
+        node* const new_node = new node(std::move(new_value));
+        new_node->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(new_node->next, new_node, std::memory_order_release, std::memory_order_relaxed))
+            ;
+    }
+
+    // An empty stack is not an error: returns nullopt instead of throwing,
+    // and the value comes back without a heap allocation of its own. The
+    // first call on a thread takes one of the max_hazard_pointers slots and
+    // throws std::runtime_error when they are all in use; handing the
+    // popped node to reclaim_later may allocate. If T's move constructor
+    // throws, the popped element is dropped: its node is still retired and
+    // the exception propagates.
+    std::optional<T> try_pop()
+    {
+        std::atomic<void*>& hp = get_hazard_pointer_for_current_thread();
+        node* old_head = head.load();
+        do
+        {
+            node* temp;
+            do  // loop until the hazard pointer is set to the current head
+            {
+                temp = old_head;
+                hp.store(old_head);
+                old_head = head.load();
+            } while (old_head != temp);
+        } while (old_head && !head.compare_exchange_strong(old_head, old_head->next));
+        hp.store(nullptr);
+
+        if (!old_head)
+            return std::nullopt;
+        std::optional<T> res;
+        try
+        {
+            res.emplace(std::move(old_head->data));
+        }
+        catch (...)
+        {
+            reclaim_later(old_head);
+            throw;
+        }
+        reclaim_later(old_head);
+        return res;
+    }
+
+    bool try_pop(T& value)
+    {
+        std::optional<T> res = try_pop();
+        if (!res)
+            return false;
+        value = std::move(*res);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load() == nullptr;
+    }
+};
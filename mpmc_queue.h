@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "cache_line.h"
+
+#if !defined(__cpp_lib_atomic_wait)
+#error "mpmc_queue.h needs C++20 std::atomic::wait"
+#endif
+
+
+/// === mpmc_queue
+// Bounded lock-free multi-producer/multi-consumer ring buffer, drop-in for
+// threadsafe_queue where a fixed capacity is acceptable.
+// Every slot carries a sequence number: slot i is free for the push with
+// ticket pos when sequence == pos, and holds the value for the pop with
+// ticket pos when sequence == pos + 1. try_push/try_pop claim a ticket by
+// CAS only when the slot is ready; push/wait_and_pop take the next ticket
+// unconditionally and block on the slot's sequence with std::atomic::wait.
+template<typename T>
+class mpmc_queue
+{
+private:
+    struct slot
+    {
+        std::atomic<std::size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value()
+        {
+            return std::launder(reinterpret_cast<T*>(storage));
+        }
+    };
+
+    const std::size_t mask;
+    std::unique_ptr<slot[]> buffer;
+    alignas(cache_line_size) std::atomic<std::size_t> enqueue_pos;
+    alignas(cache_line_size) std::atomic<std::size_t> dequeue_pos;
+
+    static_assert(std::is_nothrow_move_constructible<T>::value, "mpmc_queue needs a noexcept move constructor");
+
+    static std::size_t round_up_pow2(std::size_t n)
+    {
+        std::size_t res = 1;
+        while (res < n)
+            res <<= 1;
+        return res;
+    }
+
+    static void wait_for(std::atomic<std::size_t>& sequence, std::size_t expected)
+    {
+        std::size_t seq = sequence.load(std::memory_order_acquire);
+        while (seq != expected)
+        {
+            sequence.wait(seq, std::memory_order_acquire);
+            seq = sequence.load(std::memory_order_acquire);
+        }
+    }
+
+    template<typename U>
+    void store(slot& cell, std::size_t pos, U&& new_value)
+    {
+        ::new (static_cast<void*>(cell.storage)) T(std::forward<U>(new_value));
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        cell.sequence.notify_all();
+    }
+
+    T take(slot& cell, std::size_t pos)
+    {
+        T res(std::move(*cell.value()));
+        cell.value()->~T();
+        cell.sequence.store(pos + mask + 1, std::memory_order_release);
+        cell.sequence.notify_all();
+        return res;
+    }
+
+    // Claims the ticket of the next slot that is ready for a push (pop),
+    // returns false when the queue is full (empty)
+    bool claim(std::atomic<std::size_t>& position, std::size_t ready_offset, std::size_t& pos)
+    {
+        pos = position.load(std::memory_order_relaxed);
+        while (true)
+        {
+            slot& cell = buffer[pos & mask];
+            const std::size_t seq = cell.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + ready_offset);
+            if (diff == 0)
+            {
+                if (position.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return true;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = position.load(std::memory_order_relaxed);
+        }
+    }
+
+public:
+    explicit mpmc_queue(std::size_t capacity)
+        : mask(round_up_pow2(capacity < 2 ? 2 : capacity) - 1), buffer(new slot[mask + 1]), enqueue_pos(0), dequeue_pos(0)
+    {
+        for (std::size_t i = 0; i <= mask; ++i)
+            buffer[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    mpmc_queue(const mpmc_queue&) = delete;
+    mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+    ~mpmc_queue()
+    {
+        const std::size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+        for (std::size_t pos = dequeue_pos.load(std::memory_order_relaxed); static_cast<std::ptrdiff_t>(tail - pos) > 0; ++pos)
+        {
+            slot& cell = buffer[pos & mask];
+            if (cell.sequence.load(std::memory_order_relaxed) == pos + 1)
+                cell.value()->~T();
+        }
+    }
+
+    std::size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+    // Blocks while the queue is full
+    void push(T new_value)
+    {
+        const std::size_t pos = enqueue_pos.fetch_add(1, std::memory_order_relaxed);
+        slot& cell = buffer[pos & mask];
+        wait_for(cell.sequence, pos);
+        store(cell, pos, std::move(new_value));
+    }
+
+    bool try_push(T new_value)
+    {
+        std::size_t pos;
+        if (!claim(enqueue_pos, 0, pos))
+            return false;
+        store(buffer[pos & mask], pos, std::move(new_value));
+        return true;
+    }
+
+    void wait_and_pop(T& value)
+    {
+        const std::size_t pos = dequeue_pos.fetch_add(1, std::memory_order_relaxed);
+        slot& cell = buffer[pos & mask];
+        wait_for(cell.sequence, pos + 1);
+        value = take(cell, pos);
+    }
+
+    std::shared_ptr<T> wait_and_pop()
+    {
+        const std::size_t pos = dequeue_pos.fetch_add(1, std::memory_order_relaxed);
+        slot& cell = buffer[pos & mask];
+        wait_for(cell.sequence, pos + 1);
+        return std::make_shared<T>(take(cell, pos));
+    }
+
+    bool try_pop(T& value)
+    {
+        std::size_t pos;
+        if (!claim(dequeue_pos, 1, pos))
+            return false;
+        value = take(buffer[pos & mask], pos);
+        return true;
+    }
+
+    std::shared_ptr<T> try_pop()
+    {
+        std::size_t pos;
+        if (!claim(dequeue_pos, 1, pos))
+            return std::shared_ptr<T>();
+        return std::make_shared<T>(take(buffer[pos & mask], pos));
+    }
+
+    // Only a snapshot while other threads push or pop
+    bool empty() const
+    {
+        const std::size_t head = dequeue_pos.load(std::memory_order_acquire);
+        const std::size_t tail = enqueue_pos.load(std::memory_order_acquire);
+        return static_cast<std::ptrdiff_t>(tail - head) <= 0;
+    }
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "numa_topology.h"
+#include "parallel_alghr.h"
+
+
+/// === numa_allocator
+// For the big arrays the *_parallel algorithms walk: std::vector<T> zeroes
+// its elements on one thread, so every page lands on that thread's node.
+// numa_allocator maps fresh pages, cuts them into one contiguous slice per
+// node, sized by how many of the pool's threads run there (with
+// thread_pool::set_pinning workers fill the nodes in numa_topology::cpus()
+// order, and split_for gives neighbouring blocks to neighbouring splits),
+// prefers each slice on its node and faults the pages in parallel on the
+// pool.
+//
+// construct(p) with no arguments default-initializes, so vector(n) and
+// resize(n) don't walk the array serially. Fresh memory is zero, but
+// resize() after a shrink keeps the old values in the reused slots.
+template<typename T>
+class numa_allocator
+{
+private:
+    // smaller blocks come from operator new, placement is not worth a mapping
+    static constexpr std::size_t mapping_bytes = std::size_t(1) << 20;
+
+    static std::size_t page_size()
+    {
+#if defined(__linux__)
+        static const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        return page;
+#else
+        return 4096;
+#endif
+    }
+
+    static std::size_t mapped_bytes(std::size_t n)
+    {
+        const std::size_t page = page_size();
+        return (n * sizeof(T) + page - 1) / page * page;
+    }
+
+    // share of the pool's threads (calling thread included) on every node
+    static std::vector<std::size_t> threads_per_node()
+    {
+        const numa_topology& topology = numa_topology::instance();
+        std::vector<std::size_t> res(topology.nodes().size(), 0);
+        std::size_t threads = thread_pool::instance().size() + 1;
+        for (std::size_t i = 0; threads; i = (i + 1) % res.size())
+        {
+            const std::size_t take = std::min(threads, topology.nodes()[i].cpus.size());
+            res[i] += take;
+            threads -= take;
+        }
+        return res;
+    }
+
+    static void place(char* base, std::size_t bytes)
+    {
+        const std::size_t page = page_size();
+        const std::size_t pages = bytes / page;
+        const std::vector<numa_node>& nodes = numa_topology::instance().nodes();
+        if (nodes.size() > 1)
+        {
+            const std::vector<std::size_t> share = threads_per_node();
+            const std::size_t threads = thread_pool::instance().size() + 1;
+            std::size_t first_page = 0;
+            std::size_t threads_before = 0;
+            for (std::size_t i = 0; i < nodes.size(); ++i)
+            {
+                threads_before += share[i];
+                const std::size_t last_page = pages * threads_before / threads;
+                if (last_page > first_page)
+                    prefer_node(base + first_page * page, (last_page - first_page) * page, nodes[i].id);
+                first_page = last_page;
+            }
+        }
+
+        // one write per page faults it in; blocks start on page boundaries
+        const std::size_t grain = split_grain(pages, 64) * page;
+        split_for(base, bytes, grain, [page](char* block_first, char* block_last, std::size_t)
+        {
+            for (char* p = block_first; p < block_last; p += page)
+                *p = 0;
+        });
+    }
+
+public:
+    using value_type = T;
+
+    numa_allocator() noexcept = default;
+
+    template<typename U>
+    numa_allocator(const numa_allocator<U>&) noexcept
+    {}
+
+    T* allocate(std::size_t n)
+    {
+        if (n > std::size_t(-1) / sizeof(T))
+            throw std::bad_array_new_length();
+        const std::size_t bytes = n * sizeof(T);
+        if (bytes < mapping_bytes)
+        {
+            void* p = ::operator new(bytes);
+            std::memset(p, 0, bytes);
+            return static_cast<T*>(p);
+        }
+#if defined(__linux__)
+        const std::size_t total = mapped_bytes(n);
+        void* p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+        place(static_cast<char*>(p), total);
+        return static_cast<T*>(p);
+#else
+        void* p = ::operator new(bytes);
+        std::memset(p, 0, bytes);
+        return static_cast<T*>(p);
+#endif
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+#if defined(__linux__)
+        if (n * sizeof(T) >= mapping_bytes)
+        {
+            munmap(p, mapped_bytes(n));
+            return;
+        }
+#endif
+        ::operator delete(p);
+    }
+
+    template<typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>)
+    {
+        ::new (static_cast<void*>(p)) U;
+    }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const numa_allocator<T>&, const numa_allocator<U>&) noexcept
+{
+    return true;
+}
+
+template<typename T, typename U>
+bool operator!=(const numa_allocator<T>&, const numa_allocator<U>&) noexcept
+{
+    return false;
+}
+
+template<typename T>
+using numa_vector = std::vector<T, numa_allocator<T>>;
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+/// === numa_topology
+// NUMA nodes and their CPUs, read once from sysfs
+// (/sys/devices/system/node/node<N>/cpulist). Only CPUs in the affinity
+// mask of the process are kept, so taskset and container cpusets are
+// respected. Without sysfs (or off Linux) there is one node holding CPUs
+// 0 .. hardware_concurrency() - 1.
+struct numa_node
+{
+    unsigned id;
+    std::vector<unsigned> cpus;
+};
+
+class numa_topology
+{
+private:
+    std::vector<numa_node> node_list;
+    std::vector<unsigned> cpu_order;
+
+    // "0-3,8,10-11" -> 0 1 2 3 8 10 11
+    static std::vector<unsigned> parse_list(const std::string& list)
+    {
+        std::vector<unsigned> res;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ','))
+        {
+            if (range.find_first_of("0123456789") == std::string::npos)
+                continue;
+            const std::size_t dash = range.find('-');
+            const unsigned lo = static_cast<unsigned>(std::stoul(range.substr(0, dash)));
+            const unsigned hi = (dash == std::string::npos) ? lo : static_cast<unsigned>(std::stoul(range.substr(dash + 1)));
+            for (unsigned cpu = lo; cpu <= hi; ++cpu)
+                res.push_back(cpu);
+        }
+        return res;
+    }
+
+    static std::string read_line(const std::string& path)
+    {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    static bool allowed(unsigned cpu)
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0 || cpu >= CPU_SETSIZE)
+            return true;
+        return CPU_ISSET(cpu, &set);
+#else
+        (void)cpu;
+        return true;
+#endif
+    }
+
+    numa_topology()
+    {
+        const std::string sys_node = "/sys/devices/system/node/";
+        for (unsigned id : parse_list(read_line(sys_node + "online")))
+        {
+            numa_node node{ id, {} };
+            for (unsigned cpu : parse_list(read_line(sys_node + "node" + std::to_string(id) + "/cpulist")))
+                if (allowed(cpu))
+                    node.cpus.push_back(cpu);
+            if (!node.cpus.empty())
+                node_list.push_back(std::move(node));
+        }
+        if (node_list.empty())
+        {
+            numa_node node{ 0, {} };
+            const unsigned hardware_threads = std::thread::hardware_concurrency();
+            for (unsigned cpu = 0; cpu < (hardware_threads ? hardware_threads : 1); ++cpu)
+                if (allowed(cpu))
+                    node.cpus.push_back(cpu);
+            if (node.cpus.empty())
+                node.cpus.push_back(0);
+            node_list.push_back(std::move(node));
+        }
+        for (const numa_node& node : node_list)
+            cpu_order.insert(cpu_order.end(), node.cpus.begin(), node.cpus.end());
+    }
+
+public:
+    numa_topology(const numa_topology&) = delete;
+    numa_topology& operator=(const numa_topology&) = delete;
+
+    static const numa_topology& instance()
+    {
+        static const numa_topology topology;
+        return topology;
+    }
+
+    const std::vector<numa_node>& nodes() const
+    {
+        return node_list;
+    }
+
+    // All usable CPUs, node by node
+    const std::vector<unsigned>& cpus() const
+    {
+        return cpu_order;
+    }
+};
+
+
+/// === pinning and placement
+// Both return false where the system does not support them; callers go on
+// unpinned or with the default first-touch placement.
+inline bool pin_current_thread(unsigned cpu)
+{
+#if defined(__linux__)
+    if (cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// Prefers node for the pages of [addr, addr + bytes); addr must be page
+// aligned. Goes through the mbind system call, so libnuma is not needed.
+inline bool prefer_node(void* addr, std::size_t bytes, unsigned node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    const int mpol_preferred = 1;
+    const std::size_t word_bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node / word_bits + 1, 0);
+    mask[node / word_bits] = 1UL << (node % word_bits);
+    // the kernel reads maxnode - 1 bits
+    return syscall(SYS_mbind, addr, bytes, mpol_preferred, mask.data(), mask.size() * word_bits + 1, 0) == 0;
+#else
+    (void)addr;
+    (void)bytes;
+    (void)node;
+    return false;
+#endif
+}
@@ -1,4 +1,8 @@
 // paralell_accumulate.cpp : This file contains the 'main' function. Program execution begins and ends there.
+// Benchmark suite of the algorithms in parallel_alghr.h, the pipelines and
+// the Tvector.h containers against std::execution::seq/par. See
+// bench_suite.h for the options, e.g.
+//   parallel_alghorithms --sizes=1M,150M --threads=1,2,4,8 --types=int,double --out=results.json
 //
 
 
@@ -16,197 +20,581 @@
 #define PAR std::execution::par
 
 #include <iostream>
-#include <iomanip>
 #include <cmath>
 #include <random>
-#include <chrono>
 #include <vector>
 #include <algorithm>
 #include <utility>
 #include <thread>
 #include <functional>
-#include<numeric>
-#include <future>
+#include <numeric>
 #include <queue>
-#include <optional>
+#include <stack>
 #include <atomic>
-#include <condition_variable>
-
-// boost 
-#include <boost/regex.hpp>
-#include <boost/timer/timer.hpp>
+#include <string>
+#include <cstdint>
 
 //// header
 #include "parallel_alghr.h"
+#include "parallel_pipeline.h"
+#include "Tvector.h"
+#include "bench_suite.h"
 
 
 /// === helpers
-class Timer
+template<typename T>
+const char* type_name()
 {
-public:
-    Timer()
-    {
-        start = std::chrono::high_resolution_clock::now();
-    }
-
-    ~Timer()
-    {
-        auto  end = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-        std::cout << "timer: " << duration.count() << "ms" << '\n';
-    }
-
-private:
-    std::chrono::time_point<std::chrono::steady_clock> start;
-};
-
+    if constexpr (std::is_same_v<T, int>)
+        return "int";
+    else if constexpr (std::is_same_v<T, long>)
+        return "long";
+    else if constexpr (std::is_same_v<T, float>)
+        return "float";
+    else
+        return "double";
+}
 
-double sqrtd(double val)
+template<typename Fun>
+void for_each_type(const bench_options& options, Fun fun)
 {
-    return sqrt(val);
+    if (options.wants_type("int"))
+        fun(int());
+    if (options.wants_type("long"))
+        fun(long());
+    if (options.wants_type("float"))
+        fun(float());
+    if (options.wants_type("double"))
+        fun(double());
 }
 
+// Wide range for sort, find and minmax: [-1e6, 1e6] or [-1, 1)
+template<typename T>
+std::vector<T> make_data(std::size_t n, std::uint64_t seed)
+{
+    std::vector<T> v(n);
+    if constexpr (std::is_integral_v<T>)
+        generate_random_parallel(v.begin(), v.end(), T(-1'000'000), T(1'000'000), seed);
+    else
+        generate_random_parallel(v.begin(), v.end(), T(-1), T(1), seed);
+    return v;
+}
 
-/// === main
-int main()
+// Small integers in [-8, 8], also for float and double: every partial sum
+// is exact, so sums and scans are checked for equality in any order
+template<typename T>
+std::vector<T> make_steps(std::size_t n, std::uint64_t seed)
 {
-    using namespace std; 
+    std::vector<int> steps(n);
+    generate_random_parallel(steps.begin(), steps.end(), -8, 8, seed);
+    return std::vector<T>(steps.begin(), steps.end());
+}
 
-    std::cout << std::fixed << std::setprecision(1);
-    const size_t data_size = 150'000'007u;
+template<typename T>
+bench_record make_record(const char* group, const char* name, std::size_t size, std::size_t bytes, bool baseline = false)
+{
+    bench_record r;
+    r.group = group;
+    r.name = name;
+    r.type = type_name<T>();
+    r.size = size;
+    r.bytes = bytes;
+    r.baseline = baseline;
+    return r;
+}
 
-    std::default_random_engine eng; 
-    std::uniform_real_distribution<> urg(2, 50); 
+// integers are summed in 64 bits
+template<typename T>
+using sum_type = std::conditional_t<std::is_integral_v<T>, std::int64_t, T>;
 
-    auto rnd = std::bind(urg, eng); 
-    srand(std::time(nullptr));
 
-    std::vector<int> vext{1, 2, 3, 6, 0, 8, 0, 9, 7, 0, 7};
-    int val = 0;
-    remove_(vext.begin(), vext.end(), val); 
+/// === algorithm cases
+template<typename T>
+void bench_accumulate(bench_runner& run, std::size_t n)
+{
+    using S = sum_type<T>;
+    const std::vector<T> v = make_steps<T>(n, run.options.seed);
+    const S expected = std::accumulate(v.cbegin(), v.cend(), S());
+    const std::size_t bytes = n * sizeof(T);
+    S result = S();
+    auto check = [&] { return result == expected; };
+    auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("accumulate", name, n, bytes, baseline); };
+
+    run.run(rec("std::reduce (seq)", true), [&] { result = std::reduce(SEQ, v.cbegin(), v.cend(), S()); }, check);
+    run.run(rec("std::reduce (par)"), [&] { result = std::reduce(PAR, v.cbegin(), v.cend(), S()); }, check);
+    run.run(rec("std::accumulate"), [&] { result = std::accumulate(v.cbegin(), v.cend(), S()); }, check);
+    run.run(rec("accumulate_parallel"), [&] { result = accumulate_parallel(v.cbegin(), v.cend(), S()); }, check);
+    run.run(rec("accumulate_parallel_reproducible"), [&] { result = accumulate_parallel_reproducible(v.cbegin(), v.cend(), S()); }, check);
+    run.run(rec("par_view | par::sum"), [&] { result = par_view(v) | par::sum(S()); }, check);
+}
 
-    //////find parralel mine
-    {
-        vector<int> dvec(data_size);
-        generate_parallel( dvec.begin(), dvec.end(), rand);  
+template<typename T>
+void bench_scan(bench_runner& run, std::size_t n)
+{
+    const std::vector<T> v = make_steps<T>(n, run.options.seed);
+    std::vector<T> out(n);
+    const std::size_t bytes = 2 * n * sizeof(T);
+    auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("scan", name, n, bytes, baseline); };
+
+    std::vector<T> expected(n);
+    std::inclusive_scan(v.cbegin(), v.cend(), expected.begin());
+    auto check = [&] { return out == expected; };
+    run.run(rec("std::inclusive_scan (seq)", true), [&] { std::inclusive_scan(SEQ, v.cbegin(), v.cend(), out.begin()); }, check);
+    run.run(rec("std::inclusive_scan (par)"), [&] { std::inclusive_scan(PAR, v.cbegin(), v.cend(), out.begin()); }, check);
+    run.run(rec("inclusive_scan_parallel"), [&] { inclusive_scan_parallel(v.cbegin(), v.cend(), out.begin()); }, check);
+
+    std::exclusive_scan(v.cbegin(), v.cend(), expected.begin(), T(1));
+    run.run(rec("std::exclusive_scan (par)"), [&] { std::exclusive_scan(PAR, v.cbegin(), v.cend(), out.begin(), T(1)); }, check);
+    run.run(rec("exclusive_scan_parallel"), [&] { exclusive_scan_parallel(v.cbegin(), v.cend(), out.begin(), T(1)); }, check);
+
+    // doubled steps stay exact as well
+    auto twice = [](T x) { return static_cast<T>(x * 2); };
+    std::transform_inclusive_scan(v.cbegin(), v.cend(), expected.begin(), std::plus<>(), twice);
+    run.run(rec("std::transform_inclusive_scan (par)"), [&] { std::transform_inclusive_scan(PAR, v.cbegin(), v.cend(), out.begin(), std::plus<>(), twice); }, check);
+    run.run(rec("transform_inclusive_scan_parallel"), [&] { transform_inclusive_scan_parallel(v.cbegin(), v.cend(), out.begin(), std::plus<>(), twice); }, check);
+
+    std::transform_exclusive_scan(v.cbegin(), v.cend(), expected.begin(), T(1), std::plus<>(), twice);
+    run.run(rec("std::transform_exclusive_scan (par)"), [&] { std::transform_exclusive_scan(PAR, v.cbegin(), v.cend(), out.begin(), T(1), std::plus<>(), twice); }, check);
+    run.run(rec("transform_exclusive_scan_parallel"), [&] { transform_exclusive_scan_parallel(v.cbegin(), v.cend(), out.begin(), T(1), std::plus<>(), twice); }, check);
+}
 
-        boost::timer::auto_cpu_timer t(3, "%w sec wall;  %t sec cpu (%p%)\n");
-        auto it_m = max_element_parallel(dvec.begin(), dvec.end()); 
+template<typename T>
+void bench_transform(bench_runner& run, std::size_t n)
+{
+    const std::vector<T> v = make_data<T>(n, run.options.seed);
+    std::vector<T> out(n);
+    std::vector<T> expected(n);
+    auto op = [](T x) { return static_cast<T>(x * 3 + 1); };
+    std::transform(v.cbegin(), v.cend(), expected.begin(), op);
+    const std::size_t bytes = 2 * n * sizeof(T);
+    auto check = [&] { return out == expected; };
+    auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("transform", name, n, bytes, baseline); };
+
+    run.run(rec("std::transform (seq)", true), [&] { std::transform(SEQ, v.cbegin(), v.cend(), out.begin(), op); }, check);
+    run.run(rec("std::transform (par)"), [&] { std::transform(PAR, v.cbegin(), v.cend(), out.begin(), op); }, check);
+    run.run(rec("transform_parallel"), [&] { transform_parallel(v.cbegin(), v.cend(), out.begin(), op); }, check);
+    run.run(rec("par_view | par::map | par::to"), [&] { par_view(v) | par::map(op) | par::to(out.begin()); }, check);
+}
 
-        auto it = find_parallel(dvec.begin(), dvec.end(), 9);    
-        if (it != dvec.end())
-            std::cout << *it << std::endl; 
+template<typename T>
+void bench_generate(bench_runner& run, std::size_t n)
+{
+    std::vector<T> out(n);
+    const std::size_t bytes = n * sizeof(T);
+    {
+        auto seven = [] { return T(7); };
+        auto check = [&] { return std::all_of(out.cbegin(), out.cend(), [](T x) { return x == T(7); }); };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("generate", name, n, bytes, baseline); };
+        auto clear = [&] { std::fill(out.begin(), out.end(), T()); };
+        run.run(rec("std::generate (seq)", true), clear, [&] { std::generate(SEQ, out.begin(), out.end(), seven); }, check);
+        run.run(rec("std::generate (par)"), clear, [&] { std::generate(PAR, out.begin(), out.end(), seven); }, check);
+        run.run(rec("generate_parallel"), clear, [&] { generate_parallel(out.begin(), out.end(), seven); }, check);
     }
-
-
-    //////find_par 
     {
-
-        vector<int> dvec(data_size);
-        generate_parallel(dvec.begin(), dvec.end(), rand); 
-        boost::timer::auto_cpu_timer t(3, "%w sec wall;  %t sec cpu (%p%)\n");
-        auto it = find(PAR, dvec.begin(), dvec.end(), rand()); 
-        if (it != dvec.end()) 
-            std::cout << *it << std::endl; 
+        const T lo = T(2);
+        const T hi = T(50);
+        auto check = [&] { return std::all_of(out.cbegin(), out.cend(), [lo, hi](T x) { return lo <= x && x <= hi; }); };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("random", name, n, bytes, baseline); };
+        run.run(rec("std::generate mt19937_64 (seq)", true), [&]
+        {
+            std::mt19937_64 eng(run.options.seed);
+            if constexpr (std::is_integral_v<T>)
+            {
+                std::uniform_int_distribution<T> dist(lo, hi);
+                std::generate(SEQ, out.begin(), out.end(), [&] { return dist(eng); });
+            }
+            else
+            {
+                std::uniform_real_distribution<T> dist(lo, hi);
+                std::generate(SEQ, out.begin(), out.end(), [&] { return dist(eng); });
+            }
+        }, check);
+        run.run(rec("generate_random_parallel"), [&] { generate_random_parallel(out.begin(), out.end(), lo, hi, run.options.seed); }, check);
     }
+}
 
-    ////generate
+template<typename T>
+void bench_find(bench_runner& run, std::size_t n)
+{
+    const std::vector<T> v = make_data<T>(n, run.options.seed);
+    const std::size_t bytes = n * sizeof(T);
     {
-        boost::timer::auto_cpu_timer t;
-        Timer m;
-        vector<double> dvec(data_size);
-        generate_parallel( dvec.begin(), dvec.end(), rnd);
-        std::cout << "===== Own implementation of parallel generate ==========\n";
+        // absent, so every element is scanned
+        const T missing = T(3'000'000);
+        typename std::vector<T>::const_iterator result;
+        auto check = [&] { return result == v.cend(); };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("find", name, n, bytes, baseline); };
+        run.run(rec("std::find (seq)", true), [&] { result = std::find(SEQ, v.cbegin(), v.cend(), missing); }, check);
+        run.run(rec("std::find (par)"), [&] { result = std::find(PAR, v.cbegin(), v.cend(), missing); }, check);
+        run.run(rec("find_parallel"), [&] { result = find_parallel(v.cbegin(), v.cend(), missing); }, check);
     }
     {
-        boost::timer::cpu_timer t;
-        Timer m;
-        vector<double> dvec(data_size);
-        generate(PAR, dvec.begin(), dvec.end(), rnd);
+        // present a third of the way in: the blocks past the first match stop early
+        const T value = v[n / 3];
+        const auto expected = std::find(v.cbegin(), v.cend(), value);
+        typename std::vector<T>::const_iterator result;
+        auto check = [&] { return result == expected; };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("find_first", name, n, bytes, baseline); };
+        run.run(rec("std::find (seq)", true), [&] { result = std::find(SEQ, v.cbegin(), v.cend(), value); }, check);
+        run.run(rec("std::find (par)"), [&] { result = std::find(PAR, v.cbegin(), v.cend(), value); }, check);
+        run.run(rec("find_parallel"), [&] { result = find_parallel(v.cbegin(), v.cend(), value); }, check);
+    }
+    {
+        // every match: the value of the middle element
+        const T value = v[n / 2];
+        std::vector<std::size_t> expected;
+        for (std::size_t i = 0; i < n; ++i)
+            if (v[i] == value)
+                expected.push_back(i);
+        std::vector<std::size_t> result;
+        auto check = [&] { return result == expected; };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("find_all", name, n, bytes, baseline); };
+        run.run(rec("index loop (seq)", true), [&]
+        {
+            result.clear();
+            for (std::size_t i = 0; i < n; ++i)
+                if (v[i] == value)
+                    result.push_back(i);
+        }, check);
+        run.run(rec("find_indices_parallel"), [&] { result = find_indices_parallel(v.cbegin(), v.cend(), value); }, check);
+        std::vector<typename std::vector<T>::const_iterator> found;
+        run.run(rec("find_parallel2 (iterators)"), [&] { found = find_parallel2(v.cbegin(), v.cend(), value); }, [&]
+        {
+            return found.size() == expected.size()
+                && std::equal(found.cbegin(), found.cend(), expected.cbegin(), [&v](auto it, std::size_t i) { return it == v.cbegin() + i; });
+        });
+        run.run(rec("find_bitmap_parallel"), [&]
+        {
+            const std::vector<std::uint64_t> bitmap = find_bitmap_parallel(v.cbegin(), v.cend(), value);
+            result.clear();
+            for (std::size_t word = 0; word < bitmap.size(); ++word)
+                if (bitmap[word])
+                    for (std::size_t bit = 0; bit < 64; ++bit)
+                        if (bitmap[word] >> bit & 1)
+                            result.push_back(word * 64 + bit);
+        }, check);
+    }
+}
 
-        std::cout << "===== PAR generate from algorithm ==========\n";
-        boost::timer::cpu_times end = t.elapsed();
-        std::cout << boost::timer::format(end)<< '\n';
-        t.stop(); 
-        if (t.is_stopped()) 
-            std::cout << t.format(2, " %t sec CPU, %w sec real// and user_t: ") << t.elapsed().user << '\n'; 
+template<typename T>
+void bench_minmax(bench_runner& run, std::size_t n)
+{
+    const std::vector<T> v = make_data<T>(n, run.options.seed);
+    const auto expected = std::minmax_element(v.cbegin(), v.cend());
+    const std::size_t bytes = n * sizeof(T);
+    std::pair<T, T> result;
+    auto check = [&] { return result.first == *expected.first && result.second == *expected.second; };
+    auto values = [](auto its) { return std::pair<T, T>(*its.first, *its.second); };
+    auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("minmax", name, n, bytes, baseline); };
+
+    run.run(rec("std::minmax_element (seq)", true), [&] { result = values(std::minmax_element(SEQ, v.cbegin(), v.cend())); }, check);
+    run.run(rec("std::minmax_element (par)"), [&] { result = values(std::minmax_element(PAR, v.cbegin(), v.cend())); }, check);
+    run.run(rec("minmax_element_parallel"), [&] { result = values(minmax_element_parallel(v.cbegin(), v.cend())); }, check);
+
+    T extreme = T();
+    auto check_max = [&] { return extreme == *expected.second; };
+    auto rec_max = [&](const char* name, bool baseline = false) { return make_record<T>("max_element", name, n, bytes, baseline); };
+    run.run(rec_max("std::max_element (seq)", true), [&] { extreme = *std::max_element(SEQ, v.cbegin(), v.cend()); }, check_max);
+    run.run(rec_max("std::max_element (par)"), [&] { extreme = *std::max_element(PAR, v.cbegin(), v.cend()); }, check_max);
+    run.run(rec_max("max_element_parallel"), [&] { extreme = *max_element_parallel(v.cbegin(), v.cend()); }, check_max);
+
+    auto check_min = [&] { return extreme == *expected.first; };
+    auto rec_min = [&](const char* name, bool baseline = false) { return make_record<T>("min_element", name, n, bytes, baseline); };
+    run.run(rec_min("std::min_element (seq)", true), [&] { extreme = *std::min_element(SEQ, v.cbegin(), v.cend()); }, check_min);
+    run.run(rec_min("std::min_element (par)"), [&] { extreme = *std::min_element(PAR, v.cbegin(), v.cend()); }, check_min);
+    run.run(rec_min("min_element_parallel"), [&] { extreme = *min_element_parallel(v.cbegin(), v.cend()); }, check_min);
+}
 
+template<typename T>
+void bench_compact(bench_runner& run, std::size_t n)
+{
+    // drops the zeros, about one element in 17
+    const std::vector<T> v = make_steps<T>(n, run.options.seed);
+    std::vector<T> expected(n);
+    expected.erase(std::remove_copy(v.cbegin(), v.cend(), expected.begin(), T(0)), expected.end());
+    std::vector<T> work(n);
+    typename std::vector<T>::iterator end;
+    auto check = [&] { return std::equal(work.begin(), end, expected.cbegin(), expected.cend()); };
+    auto copy_input = [&] { std::copy(v.cbegin(), v.cend(), work.begin()); };
+    const std::size_t bytes = (n + expected.size()) * sizeof(T);
+    {
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("remove", name, n, bytes, baseline); };
+        run.run(rec("std::remove (seq)", true), copy_input, [&] { end = std::remove(SEQ, work.begin(), work.end(), T(0)); }, check);
+        run.run(rec("std::remove (par)"), copy_input, [&] { end = std::remove(PAR, work.begin(), work.end(), T(0)); }, check);
+        run.run(rec("remove_parallel"), copy_input, [&] { end = remove_parallel(work.begin(), work.end(), T(0)); }, check);
+    }
+    {
+        auto keep = [](T x) { return x != T(0); };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("copy_if", name, n, bytes, baseline); };
+        run.run(rec("std::copy_if (seq)", true), [&] { end = std::copy_if(SEQ, v.cbegin(), v.cend(), work.begin(), keep); }, check);
+        run.run(rec("std::copy_if (par)"), [&] { end = std::copy_if(PAR, v.cbegin(), v.cend(), work.begin(), keep); }, check);
+        run.run(rec("copy_if_parallel"), [&] { end = copy_if_parallel(v.cbegin(), v.cend(), work.begin(), keep); }, check);
     }
+}
 
-    //////transform
+template<typename T>
+void bench_sort(bench_runner& run, std::size_t n)
+{
+    const std::vector<T> v = make_data<T>(n, run.options.seed);
+    std::vector<T> work(n);
+    auto copy_input = [&] { std::copy(v.cbegin(), v.cend(), work.begin()); };
     {
-        vector<double> dvec(data_size);
-        generate(PAR, dvec.begin(), dvec.end(), rnd);
-        Timer m;
-        boost::timer::auto_cpu_timer t(3,"%w real sec wall,%t CPU sec (%p%)\n");
-        transform(SEQ, dvec.cbegin(), dvec.cend(), dvec.begin(), sqrtd);
-        std::cout << "===== SEQ transform from algorithm ==========\n";
+        auto check = [&] { return std::is_sorted(work.cbegin(), work.cend()); };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("sort", name, n, 0, baseline); };
+        run.run(rec("std::sort (seq)", true), copy_input, [&] { std::sort(SEQ, work.begin(), work.end()); }, check);
+        run.run(rec("std::sort (par)"), copy_input, [&] { std::sort(PAR, work.begin(), work.end()); }, check);
+        run.run(rec("sort_parallel"), copy_input, [&] { sort_parallel(work.begin(), work.end()); }, check);
+        run.run(rec("sort_parallel (greater, sample)"), copy_input, [&] { sort_parallel(work.begin(), work.end(), std::greater<>()); },
+            [&] { return std::is_sorted(work.cbegin(), work.cend(), std::greater<>()); });
+        run.run(rec("std::stable_sort (par)"), copy_input, [&] { std::stable_sort(PAR, work.begin(), work.end()); }, check);
+        run.run(rec("stable_sort_parallel"), copy_input, [&] { stable_sort_parallel(work.begin(), work.end()); }, check);
     }
     {
-        vector<double> dvec(data_size);
-        generate(PAR, dvec.begin(), dvec.end(), rnd);
-        Timer m;
-        transform(PAR, dvec.cbegin(), dvec.cend(), dvec.begin(), sqrtd);
-        std::cout << "===== PAR transform from algorithm ==========\n";
+        const std::size_t k = std::max<std::size_t>(1, n / 100);
+        std::vector<T> expected(v);
+        std::nth_element(expected.begin(), expected.begin() + (k - 1), expected.end());
+        auto check = [&] { return std::is_sorted(work.cbegin(), work.cbegin() + k) && work[k - 1] == expected[k - 1]; };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("partial_sort", name, n, 0, baseline); };
+        run.run(rec("std::partial_sort 1% (seq)", true), copy_input, [&] { std::partial_sort(SEQ, work.begin(), work.begin() + k, work.end()); }, check);
+        run.run(rec("std::partial_sort 1% (par)"), copy_input, [&] { std::partial_sort(PAR, work.begin(), work.begin() + k, work.end()); }, check);
+        run.run(rec("partial_sort_parallel 1%"), copy_input, [&] { partial_sort_parallel(work.begin(), work.begin() + k, work.end()); }, check);
     }
+}
+
+template<typename T>
+void bench_pipeline(bench_runner& run, std::size_t n)
+{
+    // 2x, then -x: integer steps with mean 0, so every order sums exactly
+    using S = sum_type<T>;
+    const std::vector<T> v = make_steps<T>(n, run.options.seed);
+    auto twice = [](T x) { return static_cast<T>(2 * x); };
+    auto negate = [](T x) { return static_cast<T>(-x); };
+    auto both = [&](T x) { return static_cast<S>(negate(twice(x))); };
+    const S expected = std::transform_reduce(v.cbegin(), v.cend(), S(), std::plus<>(), both);
+    const std::size_t bytes = n * sizeof(T);
+    S result = S();
+    auto check = [&] { return result == expected; };
+    auto rec = [&](const char* name, bool baseline = false) { return make_record<T>("pipeline", name, n, bytes, baseline); };
+
+    run.run(rec("std::transform_reduce (seq)", true), [&] { result = std::transform_reduce(SEQ, v.cbegin(), v.cend(), S(), std::plus<>(), both); }, check);
+    run.run(rec("std::transform_reduce (par)"), [&] { result = std::transform_reduce(PAR, v.cbegin(), v.cend(), S(), std::plus<>(), both); }, check);
+    run.run(rec("transform_parallel x2 + accumulate"), [&]
+    {
+        std::vector<T> tmp(n);
+        transform_parallel(v.cbegin(), v.cend(), tmp.begin(), twice);
+        transform_parallel(tmp.cbegin(), tmp.cend(), tmp.begin(), negate);
+        result = accumulate_parallel(tmp.cbegin(), tmp.cend(), S());
+    }, check);
+    run.run(rec("par_view | map | map | sum"), [&] { result = par_view(v) | par::map(twice) | par::map(negate) | par::sum(S()); }, check);
+}
+
+
+/// === container cases
+// The containers are driven by as many std::threads as the run has threads.
+// Operation counts are capped, a 150M-element sweep would mostly time locks.
+std::size_t const max_container_ops = 4'000'000;
+
+unsigned run_threads()
+{
+    return static_cast<unsigned>(thread_pool::instance().size() + 1);
+}
+
+template<typename Body>
+void on_threads(unsigned count, Body body)
+{
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < count; ++t)
+        threads.emplace_back(body, t);
+    for (std::thread& th : threads)
+        th.join();
+}
 
+void bench_tvector(bench_runner& run, std::size_t n)
+{
+    const std::size_t ops = std::min(n, max_container_ops);
+    const unsigned threads = run_threads();
     {
-        vector<double> dvec(data_size);
-        generate(PAR,dvec.begin(), dvec.end(), rnd);
-        Timer m;
-        transform_parallel(dvec.begin(), dvec.end(), dvec.begin(), sqrtd);
-        std::cout << "===== Own implementation of parallel transform ==========\n";
+        std::vector<int> plain;
+        Tvector<int> tv;
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<int>("tvector_push", name, ops, 0, baseline); };
+        run.run(rec("std::vector push_back (seq)", true), [&] { plain.clear(); },
+            [&] { for (std::size_t i = 0; i < ops; ++i) plain.push_back(static_cast<int>(i)); },
+            [&] { return plain.size() == ops; });
+        run.run(rec("Tvector push_back (all threads)"), [&] { tv.clear(); }, [&]
+        {
+            on_threads(threads, [&](unsigned t)
+            {
+                for (std::size_t i = t; i < ops; i += threads)
+                    tv.push_back(static_cast<int>(i));
+            });
+        }, [&] { return tv.size() == ops; });
     }
-    std::cout << endl;
-
-
-   ///par algorithm
-    std::cout.imbue(std::locale("en_US.UTF-8"));
-    auto eval = [](auto fun)
-    {
-        const auto t1 = std::chrono::high_resolution_clock::now();
-        const auto [name, result] = fun();
-        const auto t2 = std::chrono::high_resolution_clock::now();
-        const std::chrono::duration<double, std::milli> ms = t2 - t1;
-        std::cout << std::setw(28) << std::left << name << "\tsum: " << result << "\ttime: " << ms.count() << " ms\n";
-    };
-    
-    {
-        const std::vector<double> v(data_size, 0.1);
-
-        eval(
-            [&v] { return make_pair("std::accumulate (double)", std::accumulate(v.cbegin(), v.cend(), 0.0)); } 
-        );
-        eval(
-            [&v] { return make_pair("std::reduce (seq, double)", std::reduce(SEQ, v.cbegin(), v.cend())); } 
-        );
-        eval(
-            [&v] { return make_pair("std::reduce (par, double)", std::reduce(PAR, v.cbegin(), v.cend())); } 
-        );
-        eval(
-            [&v] { return make_pair("accumulate_parallel (double)", accumulate_parallel(v.cbegin(), v.cend(), 0.0)); } 
-        );
+    {
+        const std::vector<int> v = make_data<int>(n, run.options.seed);
+        Tvector<int> tv;
+        for (int x : v)
+            tv.push_back(x);
+        const auto expected = std::minmax_element(v.cbegin(), v.cend());
+        std::pair<int, int> result;
+        auto check = [&] { return result.first == *expected.first && result.second == *expected.second; };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<int>("tvector_minmax", name, n, n * sizeof(int), baseline); };
+        run.run(rec("std::minmax_element (seq)", true), [&]
+        {
+            const auto its = std::minmax_element(SEQ, v.cbegin(), v.cend());
+            result = { *its.first, *its.second };
+        }, check);
+        run.run(rec("Tvector::get_minmax"), [&] { result = tv.get_minmax(); }, check);
+        run.run(rec("Tvector::get_min + get_max"), [&] { result = { tv.get_min(), tv.get_max() }; }, check);
     }
-
-    std::cout << endl;
-    {
-        const std::vector<long> v(data_size, 1); 
-
-        eval(
-            [&v] { return make_pair("std::accumulate (long)", std::accumulate(v.cbegin(), v.cend(), 0l)); }
-        );
-        eval(
-            [&v] { return make_pair("std::reduce (seq, long)", std::reduce(SEQ, v.cbegin(), v.cend())); }
-        );
-        eval(
-            [&v] { return make_pair("std::reduce (par, long)", std::reduce(PAR, v.cbegin(), v.cend())); }
-        );
-        eval(
-            [&v] { return make_pair("accumulate_parallel (long)", accumulate_parallel(v.cbegin(), v.cend(), 0l)); }
-        );
+    {
+        // one lock per element against one lock per pass
+        const std::vector<int> v = make_data<int>(ops, run.options.seed);
+        Tvector<int> tv;
+        for (int x : v)
+            tv.push_back(x);
+        const Tvector<int>& ctv = tv;
+        const std::int64_t expected = std::accumulate(v.cbegin(), v.cend(), std::int64_t());
+        std::int64_t result = 0;
+        auto check = [&] { return result == expected; };
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<int>("tvector_bulk", name, ops, ops * sizeof(int), baseline); };
+        run.run(rec("std::accumulate (std::vector)", true), [&] { result = std::accumulate(v.cbegin(), v.cend(), std::int64_t()); }, check);
+        run.run(rec("Tvector operator[] loop"), [&]
+        {
+            result = 0;
+            for (std::size_t i = 0; i < ops; ++i)
+                result += ctv[i];
+        }, check);
+        run.run(rec("Tvector::with_lock + std::accumulate"), [&]
+        {
+            result = ctv.with_lock([](tvector_span<const int> s) { return std::accumulate(s.begin(), s.end(), std::int64_t()); });
+        }, check);
+        run.run(rec("accumulate_parallel(Tvector)"), [&] { result = accumulate_parallel(ctv, std::int64_t()); }, check);
+        run.run(rec("accumulate_parallel (std::vector)"), [&] { result = accumulate_parallel(v.cbegin(), v.cend(), std::int64_t()); }, check);
     }
+}
 
+// Half the threads push, the other half pop (at least one of each)
+template<typename Push, typename Pop>
+bool producers_consumers(unsigned threads, std::size_t ops, Push push, Pop pop)
+{
+    const unsigned producers = std::max(1u, threads / 2);
+    const unsigned consumers = std::max(1u, threads - producers);
+    std::atomic<std::int64_t> popped_sum(0);
+    on_threads(producers + consumers, [&](unsigned t)
+    {
+        if (t < producers)
+        {
+            for (std::size_t i = t; i < ops; i += producers)
+                push(static_cast<int>(i));
+        }
+        else
+        {
+            const unsigned c = t - producers;
+            const std::size_t share = ops / consumers + (c < ops % consumers ? 1 : 0);
+            std::int64_t sum = 0;
+            for (std::size_t i = 0; i < share; ++i)
+                sum += pop();
+            popped_sum += sum;
+        }
+    });
+    return popped_sum == static_cast<std::int64_t>(ops) * static_cast<std::int64_t>(ops - 1) / 2;
+}
 
-    return 0;
+void bench_queue_stack(bench_runner& run, std::size_t n)
+{
+    const std::size_t ops = std::min(n, max_container_ops);
+    const unsigned threads = run_threads();
+    bool ok = true;
+    auto check = [&] { return ok; };
+    {
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<int>("queue", name, ops, 0, baseline); };
+        run.run(rec("std::queue push + pop (seq)", true), [&]
+        {
+            std::queue<int> q;
+            for (std::size_t i = 0; i < ops; ++i)
+                q.push(static_cast<int>(i));
+            std::int64_t sum = 0;
+            for (; !q.empty(); q.pop())
+                sum += q.front();
+            ok = sum == static_cast<std::int64_t>(ops) * static_cast<std::int64_t>(ops - 1) / 2;
+        }, check);
+        run.run(rec("threadsafe_queue producers/consumers"), [&]
+        {
+            threadsafe_queue<int> q;
+            ok = producers_consumers(threads, ops, [&q](int x) { q.push(x); }, [&q] { int x; q.wait_and_pop(x); return x; });
+        }, check);
+    }
+    {
+        auto rec = [&](const char* name, bool baseline = false) { return make_record<int>("stack", name, ops, 0, baseline); };
+        run.run(rec("std::stack push + pop (seq)", true), [&]
+        {
+            std::stack<int> s;
+            for (std::size_t i = 0; i < ops; ++i)
+                s.push(static_cast<int>(i));
+            std::int64_t sum = 0;
+            for (; !s.empty(); s.pop())
+                sum += s.top();
+            ok = sum == static_cast<std::int64_t>(ops) * static_cast<std::int64_t>(ops - 1) / 2;
+        }, check);
+        run.run(rec("threadsafe_stack producers/consumers"), [&]
+        {
+            threadsafe_stack<int> s;
+            ok = producers_consumers(threads, ops, [&s](int x) { s.push(x); }, [&s]
+            {
+                // no blocking pop: spin on empty_stack
+                for (;;)
+                {
+                    try
+                    {
+                        int x;
+                        s.pop(x);
+                        return x;
+                    }
+                    catch (const empty_stack&)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }, check);
+    }
 }
 
+
+/// === main
+int main(int argc, char* argv[])
+{
+    return run_bench_suite(argc, argv, [](bench_runner& run)
+    {
+        const bench_options& options = run.options;
+        for (std::size_t n : options.sizes)
+        {
+            for_each_type(options, [&](auto zero)
+            {
+                using T = decltype(zero);
+                if (options.wants_any({ "accumulate" }))
+                    bench_accumulate<T>(run, n);
+                if (options.wants_any({ "scan" }))
+                    bench_scan<T>(run, n);
+                if (options.wants_any({ "transform" }))
+                    bench_transform<T>(run, n);
+                if (options.wants_any({ "generate", "random" }))
+                    bench_generate<T>(run, n);
+                if (options.wants_any({ "find", "find_first", "find_all" }))
+                    bench_find<T>(run, n);
+                if (options.wants_any({ "minmax", "max_element", "min_element" }))
+                    bench_minmax<T>(run, n);
+                if (options.wants_any({ "remove", "copy_if" }))
+                    bench_compact<T>(run, n);
+                if (options.wants_any({ "sort", "partial_sort" }))
+                    bench_sort<T>(run, n);
+                if (options.wants_any({ "pipeline" }))
+                    bench_pipeline<T>(run, n);
+            });
+            if (options.wants_any({ "tvector_push", "tvector_minmax", "tvector_bulk" }))
+                bench_tvector(run, n);
+            if (options.wants_any({ "queue", "stack" }))
+                bench_queue_stack(run, n);
+        }
+    });
+}
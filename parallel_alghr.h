@@ -13,15 +13,248 @@
 #include <numeric>
 #include <future>
 #include <queue>
+#include <mutex>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <cstring>
+#include <optional>
+
+#include "cache_line.h"
+#include "grain_tuner.h"
+#include "parallel_trace.h"
+#include "thread_pool.h"
+#include "simd_kernels.h"
+
+
+// Iterators whose elements can be handed to the SIMD kernels as a pointer.
+// Without concepts only pointers and std::vector iterators are recognized.
+template<typename Iterator, typename = void>
+struct is_vector_iterator : std::false_type
+{};
+
+template<typename Iterator>
+struct is_vector_iterator<Iterator, std::enable_if_t<std::is_object_v<typename std::iterator_traits<Iterator>::value_type>
+    && !std::is_same_v<typename std::iterator_traits<Iterator>::value_type, bool>>>
+    : std::bool_constant<std::is_same_v<Iterator, typename std::vector<typename std::iterator_traits<Iterator>::value_type>::iterator>
+        || std::is_same_v<Iterator, typename std::vector<typename std::iterator_traits<Iterator>::value_type>::const_iterator>>
+{};
+
+template<typename Iterator>
+constexpr bool is_contiguous_iterator_v =
+#if defined(__cpp_lib_concepts)
+    std::contiguous_iterator<Iterator>;
+#else
+    std::is_pointer_v<Iterator> || is_vector_iterator<Iterator>::value;
+#endif
+
+
+/// === recursive splitting on the shared pool
+// A range is halved (on multiples of grain) until a piece is at most grain
+// elements long. The left half is handed to the pool and the right half is
+// processed in place, so idle workers steal the biggest pieces left and a
+// slow block no longer holds up the whole call.
+inline std::size_t split_grain(std::size_t length, std::size_t min_per_thread)
+{
+    const std::size_t blocks_per_thread = 8;
+    const std::size_t threads = thread_pool::instance().size() + 1;
+    return std::max(min_per_thread, length / (threads * blocks_per_thread));
+}
+
+inline std::size_t split_half(std::size_t length, std::size_t grain)
+{
+    const std::size_t blocks = (length + grain - 1) / grain;
+    return blocks / 2 * grain;
+}
+
+// block(first, last, offset) -> R, combine(R left, R right) -> R
+template<typename Iterator, typename Block, typename Combine>
+auto split_reduce(Iterator first, std::size_t length, std::size_t grain, const Block& block, const Combine& combine, std::size_t offset = 0)
+    -> decltype(block(first, first, offset))
+{
+    if (length <= grain)
+    {
+        PAR_TRACE_BLOCK(offset, length);
+        Iterator last = first;
+        std::advance(last, length);
+        return block(first, last, offset);
+    }
+    const std::size_t half = split_half(length, grain);
+    Iterator middle = first;
+    std::advance(middle, half);
+
+    thread_pool& pool = thread_pool::instance();
+    PAR_TRACE_FORK(fork);
+    auto left = pool.submit([&] { PAR_TRACE_TASK(fork); return split_reduce(first, half, grain, block, combine, offset); });
+    try
+    {
+        auto right = split_reduce(middle, length - half, grain, block, combine, offset + half);
+        {
+            PAR_TRACE_JOIN();
+            pool.wait(left);
+        }
+        return combine(left.get(), std::move(right));
+    }
+    catch (...)
+    {
+        if (left.valid())
+            pool.wait(left);
+        throw;
+    }
+}
+
+// block(first, last, offset)
+template<typename Iterator, typename Block>
+void split_for(Iterator first, std::size_t length, std::size_t grain, const Block& block, std::size_t offset = 0)
+{
+    if (length <= grain)
+    {
+        PAR_TRACE_BLOCK(offset, length);
+        Iterator last = first;
+        std::advance(last, length);
+        block(first, last, offset);
+        return;
+    }
+    const std::size_t half = split_half(length, grain);
+    Iterator middle = first;
+    std::advance(middle, half);
+
+    thread_pool& pool = thread_pool::instance();
+    PAR_TRACE_FORK(fork);
+    auto left = pool.submit([&] { PAR_TRACE_TASK(fork); split_for(first, half, grain, block, offset); });
+    try
+    {
+        split_for(middle, length - half, grain, block, offset + half);
+    }
+    catch (...)
+    {
+        pool.wait(left);
+        throw;
+    }
+    {
+        PAR_TRACE_JOIN();
+        pool.wait(left);
+    }
+    left.get();
+}
+
+/// === split_reduce_tuned / split_for_tuned
+// split_reduce/split_for with the grain taken from grain_tuner. The first
+// call of a key runs the block serially on pieces of 256, 512, ... elements
+// until about grain_tuner::probe_ns have passed; that is real work, so
+// nothing is computed twice. The cost per element is then recorded and the
+// rest of the range is split. Later calls split at once, and a range not
+// worth two tasks runs as one block on the calling thread.
+// probe(result) returns false if the block stopped before the end of its
+// piece (find_parallel past a match); the time then says nothing about the
+// cost per element, so the probe ends there and records nothing.
+template<typename Iterator, typename Block, typename Probe>
+std::size_t tuned_probe(const std::string& key, Iterator& first, std::size_t length, const Block& block, const Probe& probe)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> elapsed(0);
+    std::size_t done = 0;
+    bool complete = true;
+    for (std::size_t piece = grain_tuner::probe_first_piece; complete && done < length && elapsed.count() < grain_tuner::probe_ns; piece *= 2)
+    {
+        const std::size_t n = std::min(piece, length - done);
+        Iterator piece_last = first;
+        std::advance(piece_last, n);
+        PAR_TRACE_BLOCK(done, n);
+        complete = probe(block(first, piece_last, done));
+        first = piece_last;
+        done += n;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    if (complete && elapsed.count() >= grain_tuner::min_probe_ns)
+        grain_tuner::instance().record(key, elapsed.count() / done);
+    return done;
+}
+
+// block(first, last, offset) -> R, combine(R left, R right) -> R
+template<typename Iterator, typename Block, typename Combine>
+auto split_reduce_tuned(const char* algorithm, Iterator first, std::size_t length, const Block& block, const Combine& combine)
+    -> decltype(block(first, first, 0))
+{
+    using R = decltype(block(first, first, 0));
+    PAR_TRACE_CALL(algorithm, length);
+    grain_tuner& tuner = grain_tuner::instance();
+    static const std::string key = grain_tuner::key<Block>(algorithm);
+
+    if (const std::optional<double> cost = tuner.cost(key))
+        return split_reduce(first, length, split_grain(length, tuner.min_grain(*cost)), block, combine);
+
+    std::optional<R> head;
+    const std::size_t done = tuned_probe(key, first, length, block, [&head, &combine](R piece)
+    {
+        if (head)
+            head.emplace(combine(std::move(*head), std::move(piece)));
+        else
+            head.emplace(std::move(piece));
+        return true;
+    });
+    if (done == length)
+        return std::move(*head);
+
+    const std::optional<double> cost = tuner.cost(key);
+    const std::size_t rest = length - done;
+    const std::size_t grain = cost ? split_grain(rest, tuner.min_grain(*cost)) : rest;
+    return combine(std::move(*head), split_reduce(first, rest, grain, block, combine, done));
+}
+
+// Grain of at least min_grain for length elements, rounded up to a
+// multiple of grain_multiple
+inline std::size_t tuned_grain(std::size_t length, std::size_t min_grain, std::size_t grain_multiple)
+{
+    return (split_grain(length, min_grain) + grain_multiple - 1) / grain_multiple * grain_multiple;
+}
+
+// block(first, last, offset), may return false when it stopped early.
+// Every block starts at a multiple of grain_multiple, which must divide
+// grain_tuner::probe_first_piece (the probe pieces are multiples of it).
+template<typename Iterator, typename Block>
+void split_for_tuned(const char* algorithm, Iterator first, std::size_t length, const Block& block, std::size_t grain_multiple = 1)
+{
+    PAR_TRACE_CALL(algorithm, length);
+    grain_tuner& tuner = grain_tuner::instance();
+    static const std::string key = grain_tuner::key<Block>(algorithm);
+
+    if (const std::optional<double> cost = tuner.cost(key))
+    {
+        split_for(first, length, tuned_grain(length, tuner.min_grain(*cost), grain_multiple), block);
+        return;
+    }
+
+    const std::size_t done = tuned_probe(key, first, length, [&block](Iterator block_first, Iterator block_last, std::size_t offset)
+    {
+        if constexpr (std::is_void_v<decltype(block(block_first, block_last, offset))>)
+        {
+            block(block_first, block_last, offset);
+            return true;
+        }
+        else
+            return static_cast<bool>(block(block_first, block_last, offset));
+    }, [](bool complete) { return complete; });
+    if (done == length)
+        return;
+
+    const std::optional<double> cost = tuner.cost(key);
+    const std::size_t rest = length - done;
+    split_for(first, rest, cost ? tuned_grain(rest, tuner.min_grain(*cost), grain_multiple) : rest, block, done);
+}
 
 
 /// === accumulate_parallel
 template<typename Iterator, typename T>
 struct accumulate_block
 {
-    void operator()(Iterator first, Iterator last, T& result)
+    T operator()(Iterator first, Iterator last)
     {
-        result = std::accumulate(first, last, result);
+        return std::accumulate(first, last, T());
     }
 };
 
@@ -31,26 +264,319 @@ T accumulate_parallel(Iterator first, Iterator last, T init)
     unsigned long const length = std::distance(first, last);
     if (!length)
         return init;
-    unsigned long const min_per_thread = 250;
-    unsigned long const max_threads = (length + min_per_thread - 1) / min_per_thread;
-    unsigned long const hardware_threads = std::thread::hardware_concurrency();
-    unsigned long const num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
-    unsigned long const block_size = length / num_threads;
+    T const result = split_reduce_tuned("accumulate_parallel", first, length,
+        [](Iterator block_first, Iterator block_last, std::size_t) { return accumulate_block<Iterator, T>()(block_first, block_last); },
+        [](T left, T right) { return left + right; });
+    return init + result;
+}
+
+/// === accumulate_parallel_reproducible
+// Same result, bit for bit, for any number of threads: chunks have a fixed
+// size, so the chunk boundaries and the split_reduce combine tree depend on
+// the length only. Floating-point chunks are summed with Neumaier
+// compensation, which also removes most of the drift of long sums.
+std::size_t const reproducible_chunk = 16384;
+
+template<typename Iterator, typename T>
+struct accumulate_reproducible_block
+{
+    using element_type = typename std::iterator_traits<Iterator>::value_type;
 
-    std::vector<T> results(num_threads);
-    std::vector<std::thread> threads(num_threads - 1);
-    Iterator block_start = first;
-    for (size_t i = 0; i < (num_threads - 1); ++i)
+    compensated_sum<T> operator()(Iterator first, Iterator last)
     {
-        Iterator block_end = block_start;
-        std::advance(block_end, block_size);
-        threads[i] = std::thread(accumulate_block<Iterator, T>(), block_start, block_end, std::ref(results[i]));
-        block_start = block_end;
+        const std::size_t n = std::distance(first, last);
+        if constexpr (std::is_floating_point_v<T> && std::is_same_v<T, element_type>)
+        {
+            if constexpr (is_contiguous_iterator_v<Iterator>)
+                return neumaier_sum_n(std::addressof(*first), n);
+            else
+                return neumaier_sum_n(first, n);
+        }
+        else
+            return compensated_sum<T>{ std::accumulate(first, last, T()), T() };
     }
-    accumulate_block<Iterator, T>()(block_start, last, results[num_threads - 1]);
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
-    return std::accumulate(results.begin(), results.end(), init);
+};
+
+template<typename Iterator, typename T>
+T accumulate_parallel_reproducible(Iterator first, Iterator last, T init)
+{
+    const std::size_t length = std::distance(first, last);
+    if (!length)
+        return init;
+    PAR_TRACE_CALL("accumulate_parallel_reproducible", length);
+
+    const compensated_sum<T> total = split_reduce(first, length, reproducible_chunk,
+        [](Iterator block_first, Iterator block_last, std::size_t) { return accumulate_reproducible_block<Iterator, T>()(block_first, block_last); },
+        [](compensated_sum<T> left, compensated_sum<T> right)
+        {
+            if constexpr (std::is_floating_point_v<T>)
+                return neumaier_combine(left, right);
+            else
+                return compensated_sum<T>{ left.sum + right.sum, T() };
+        });
 
+    if constexpr (std::is_floating_point_v<T>)
+        return neumaier_combine(compensated_sum<T>{ init, T() }, total).value();
+    else
+        return init + total.sum;
+}
+
+/// === inclusive_scan_parallel / exclusive_scan_parallel
+// Single-pass scan with decoupled look-back: tiles are handed out in order
+// from an atomic ticket. A tile folds its elements, publishes that aggregate
+// and walks back over its predecessors, adding their aggregates until it
+// meets one that has already published its inclusive prefix. It then
+// publishes its own prefix and scans its elements, which are still in cache,
+// so each element is read once from memory and written once (about 2N
+// traffic instead of 3N for reduce-then-scan). A tile only waits for tiles
+// with a smaller ticket, which are already being worked on, so this cannot
+// deadlock. op must be associative; the grouping differs from the std::
+// version, so floating-point results may differ in the last bits.
+// Iterators that are not random access, and short ranges, use the serial
+// std:: algorithm.
+std::size_t const scan_tile_size = 8192;
+
+template<typename T>
+struct alignas(cache_line_size) scan_tile
+{
+    enum : unsigned char { empty, aggregate_ready, prefix_ready };
+
+    std::atomic<unsigned char> status{ empty };
+    std::optional<T> aggregate;
+    std::optional<T> prefix;
+};
+
+// Tiles handed out in ticket order plus their look-back state
+template<typename T>
+class ordered_tiles
+{
+private:
+    std::size_t tiles;
+    std::unique_ptr<scan_tile<T>[]> state;
+    std::atomic<std::size_t> next_tile;
+    std::atomic<bool> failed;
+
+public:
+    explicit ordered_tiles(std::size_t tiles_) : tiles(tiles_), state(new scan_tile<T>[tiles_]), next_tile(0), failed(false)
+    {}
+
+    // Calls tile_fn(t) -> bool for every tile on the calling thread and up to
+    // pool.size() workers; false stops the caller. If tile_fn throws, the
+    // other callers stop too and the first exception is rethrown.
+    template<typename TileFn>
+    void run(TileFn tile_fn)
+    {
+        auto take_tiles = [&]
+        {
+            try
+            {
+                for (std::size_t t = next_tile.fetch_add(1); t < tiles; t = next_tile.fetch_add(1))
+                {
+                    // offset is the tile number
+                    PAR_TRACE_BLOCK(t, 1);
+                    if (!tile_fn(t))
+                        return;
+                }
+            }
+            catch (...)
+            {
+                failed.store(true);
+                throw;
+            }
+        };
+
+        thread_pool& pool = thread_pool::instance();
+        task_group group(pool);
+        PAR_TRACE_FORK(fork);
+        for (std::size_t i = 0; i < std::min<std::size_t>(pool.size(), tiles - 1); ++i)
+            group.spawn([&] { PAR_TRACE_TASK(fork); take_tiles(); });
+        take_tiles();
+        PAR_TRACE_JOIN();
+        group.wait();
+    }
+
+    // Publishes the aggregate of tile t, sets carry to init op (everything
+    // before tile t), or leaves it empty for the first tile without init,
+    // and publishes the inclusive prefix of t. False if another tile failed.
+    template<typename BinaryOp>
+    bool publish(std::size_t t, const T& aggregate, const std::optional<T>& init, const BinaryOp& op, std::optional<T>& carry)
+    {
+        scan_tile<T>& tile = state[t];
+        carry = init;
+        if (t > 0)
+        {
+            tile.aggregate = aggregate;
+            tile.status.store(scan_tile<T>::aggregate_ready, std::memory_order_release);
+
+            std::optional<T> before;
+            for (std::size_t p = t; p-- > 0; )
+            {
+                const scan_tile<T>& pred = state[p];
+                unsigned char status;
+                while ((status = pred.status.load(std::memory_order_acquire)) == scan_tile<T>::empty)
+                {
+                    if (failed.load(std::memory_order_relaxed))
+                        return false;
+                    std::this_thread::yield();
+                }
+                const T& value = status == scan_tile<T>::prefix_ready ? *pred.prefix : *pred.aggregate;
+                if (before)
+                    before = op(value, std::move(*before));
+                else
+                    before = value;
+                if (status == scan_tile<T>::prefix_ready)
+                    break;
+            }
+            // the first tile publishes a prefix that already contains init
+            carry = std::move(before);
+        }
+        if (carry)
+            tile.prefix = op(*carry, aggregate);
+        else
+            tile.prefix = aggregate;
+        tile.status.store(scan_tile<T>::prefix_ready, std::memory_order_release);
+        return true;
+    }
+
+    // Inclusive prefix of tile t, once run() has returned
+    const T& prefix(std::size_t t) const
+    {
+        return *state[t].prefix;
+    }
+};
+
+struct scan_identity
+{
+    template<typename U>
+    const U& operator()(const U& value) const
+    {
+        return value;
+    }
+};
+
+template<bool exclusive, typename T, typename InputIt, typename OutputIt, typename BinaryOp, typename UnaryOp>
+OutputIt scan_parallel(InputIt first, InputIt last, OutputIt d_first, std::optional<T> init, BinaryOp op, UnaryOp unary)
+{
+    using input_category = typename std::iterator_traits<InputIt>::iterator_category;
+    using output_category = typename std::iterator_traits<OutputIt>::iterator_category;
+    const std::size_t length = std::distance(first, last);
+    const std::size_t tiles = (length + scan_tile_size - 1) / scan_tile_size;
+    PAR_TRACE_CALL(exclusive ? "exclusive_scan_parallel" : "inclusive_scan_parallel", length);
+
+    if constexpr (!std::is_base_of_v<std::random_access_iterator_tag, input_category> || !std::is_base_of_v<std::random_access_iterator_tag, output_category>)
+    {
+        if constexpr (exclusive)
+            return std::transform_exclusive_scan(first, last, d_first, *init, op, unary);
+        else if (init)
+            return std::transform_inclusive_scan(first, last, d_first, op, unary, *init);
+        else
+            return std::transform_inclusive_scan(first, last, d_first, op, unary);
+    }
+    else
+    {
+        if (tiles < 2 || thread_pool::instance().size() == 0)
+        {
+            if constexpr (exclusive)
+                return std::transform_exclusive_scan(first, last, d_first, *init, op, unary);
+            else if (init)
+                return std::transform_inclusive_scan(first, last, d_first, op, unary, *init);
+            else
+                return std::transform_inclusive_scan(first, last, d_first, op, unary);
+        }
+
+        ordered_tiles<T> state(tiles);
+        state.run([&](std::size_t t)
+        {
+            const InputIt tile_first = first + t * scan_tile_size;
+            const InputIt tile_last = first + std::min(length, (t + 1) * scan_tile_size);
+
+            T aggregate = unary(*tile_first);
+            for (InputIt it = tile_first + 1; it != tile_last; ++it)
+                aggregate = op(std::move(aggregate), unary(*it));
+
+            // everything before this tile, init included
+            std::optional<T> carry;
+            if (!state.publish(t, aggregate, init, op, carry))
+                return false;
+
+            // read each element before writing, first may equal d_first
+            OutputIt out = d_first + t * scan_tile_size;
+            InputIt it = tile_first;
+            if constexpr (exclusive)
+            {
+                T acc = std::move(*carry);
+                for (; it != tile_last; ++it, ++out)
+                {
+                    T value = unary(*it);
+                    *out = acc;
+                    acc = op(std::move(acc), std::move(value));
+                }
+            }
+            else
+            {
+                T acc = carry ? T(op(std::move(*carry), unary(*it))) : T(unary(*it));
+                *out = acc;
+                for (++it, ++out; it != tile_last; ++it, ++out)
+                {
+                    acc = op(std::move(acc), unary(*it));
+                    *out = acc;
+                }
+            }
+            return true;
+        });
+        return d_first + length;
+    }
+}
+
+template<typename InputIt, typename OutputIt>
+OutputIt inclusive_scan_parallel(InputIt first, InputIt last, OutputIt d_first)
+{
+    using T = typename std::iterator_traits<InputIt>::value_type;
+    return scan_parallel<false, T>(first, last, d_first, std::optional<T>(), std::plus<>(), scan_identity());
+}
+
+template<typename InputIt, typename OutputIt, typename BinaryOp>
+OutputIt inclusive_scan_parallel(InputIt first, InputIt last, OutputIt d_first, BinaryOp op)
+{
+    using T = typename std::iterator_traits<InputIt>::value_type;
+    return scan_parallel<false, T>(first, last, d_first, std::optional<T>(), op, scan_identity());
+}
+
+template<typename InputIt, typename OutputIt, typename BinaryOp, typename T>
+OutputIt inclusive_scan_parallel(InputIt first, InputIt last, OutputIt d_first, BinaryOp op, T init)
+{
+    return scan_parallel<false, T>(first, last, d_first, std::optional<T>(std::move(init)), op, scan_identity());
+}
+
+template<typename InputIt, typename OutputIt, typename T>
+OutputIt exclusive_scan_parallel(InputIt first, InputIt last, OutputIt d_first, T init)
+{
+    return scan_parallel<true, T>(first, last, d_first, std::optional<T>(std::move(init)), std::plus<>(), scan_identity());
+}
+
+template<typename InputIt, typename OutputIt, typename T, typename BinaryOp>
+OutputIt exclusive_scan_parallel(InputIt first, InputIt last, OutputIt d_first, T init, BinaryOp op)
+{
+    return scan_parallel<true, T>(first, last, d_first, std::optional<T>(std::move(init)), op, scan_identity());
+}
+
+template<typename InputIt, typename OutputIt, typename BinaryOp, typename UnaryOp>
+OutputIt transform_inclusive_scan_parallel(InputIt first, InputIt last, OutputIt d_first, BinaryOp op, UnaryOp unary)
+{
+    using T = std::decay_t<std::invoke_result_t<UnaryOp&, typename std::iterator_traits<InputIt>::reference>>;
+    return scan_parallel<false, T>(first, last, d_first, std::optional<T>(), op, unary);
+}
+
+template<typename InputIt, typename OutputIt, typename BinaryOp, typename UnaryOp, typename T>
+OutputIt transform_inclusive_scan_parallel(InputIt first, InputIt last, OutputIt d_first, BinaryOp op, UnaryOp unary, T init)
+{
+    return scan_parallel<false, T>(first, last, d_first, std::optional<T>(std::move(init)), op, unary);
+}
+
+template<typename InputIt, typename OutputIt, typename T, typename BinaryOp, typename UnaryOp>
+OutputIt transform_exclusive_scan_parallel(InputIt first, InputIt last, OutputIt d_first, T init, BinaryOp op, UnaryOp unary)
+{
+    return scan_parallel<true, T>(first, last, d_first, std::optional<T>(std::move(init)), op, unary);
 }
 
 /// === transform_parallel
@@ -62,26 +588,12 @@ void transform_parallel(InputIt first1, InputIt last1, OutputIt d_first, UnaryOp
     if (!length)
         return;
 
-    unsigned long const min_per_thread = 250;
-    unsigned long const max_threads = (length + min_per_thread - 1) / min_per_thread;
-    unsigned long const hardware_threads = std::thread::hardware_concurrency();
-    unsigned long const num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
-    unsigned long const block_size = length / num_threads;
-
-    std::vector<std::thread> threads(num_threads - 1);
-    InputIt block_start = first1;
-    OutputIt result_start = d_first;
-    for (unsigned long i = 0; i < (num_threads - 1); ++i)
+    split_for_tuned("transform_parallel", first1, length, [d_first, &op](InputIt block_first, InputIt block_last, std::size_t offset)
     {
-        InputIt block_end = block_start;
-        std::advance(block_end, block_size);
-        // create function call in thread: std::transform(block_start, block_end, block_start, op)
-        threads[i] = std::thread(std::transform<InputIt, OutputIt, UnaryOperation>, block_start, block_end, result_start, op);
-        block_start = block_end;
-        std::advance(result_start, block_size);
-    }
-    std::transform(block_start, last1, result_start, op);
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+        OutputIt result_start = d_first;
+        std::advance(result_start, offset);
+        std::transform(block_first, block_last, result_start, op);
+    });
 }
 
 //////generat_parallel
@@ -92,47 +604,150 @@ void generate_parallel(Iterator first, Iterator last, Func f)
     if (!length)
         return;
 
-    const size_t min_per_thread = 25; 
-    const size_t max_threads = (length + min_per_thread - 1) / min_per_thread;
-    const size_t hardware_threads = (std::thread::hardware_concurrency() == 0) ? 2 : std::thread::hardware_concurrency(); 
-    const size_t num_threads = std::min(hardware_threads, max_threads); 
-    const size_t interval = length / num_threads; 
+    split_for_tuned("generate_parallel", first, length, [&f](Iterator block_first, Iterator block_last, std::size_t)
+    {
+        std::generate(block_first, block_last, f);
+    });
+}
+
+/// === generate_random_parallel
+// Replaces generate_parallel(..., rand) and copies of one engine, which
+// serialize on a lock or repeat the same numbers in every block. Element i
+// is made from the bits at position i of the Philox stream of seed only, so
+// the output is the same for any number of threads. Integers are uniform in
+// [a, b], float and double in [a, b).
+std::size_t const random_buffer_words = 1024;
 
-    std::vector<std::thread> threads;
-    threads.reserve(num_threads - 1);
-    Iterator start = first;
-    for (size_t i = 0; i < (num_threads - 1); ++i) // size - 1 main thread
+template<typename T>
+struct random_block
+{
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, long double>,
+        "generate_random_parallel needs an integer, float or double element type");
+
+    // float takes one 32-bit word, everything else a 64-bit pair
+    static constexpr std::size_t words_per_value = std::is_same_v<T, float> ? 1 : 2;
+    static constexpr std::size_t values_per_buffer = random_buffer_words / words_per_value;
+    static constexpr std::size_t groups_per_buffer = random_buffer_words / 32;
+
+    // values of buffer number buffer of the stream
+    static void fill_buffer(std::size_t buffer, T a, T b, std::uint64_t seed, T* values)
     {
-        Iterator end = start;
-        std::advance(end, interval);
-        threads.emplace_back(std::generate<Iterator, Func>, start, end, f);
-        start = end;
+        alignas(64) std::uint32_t words[random_buffer_words];
+        philox_fill(words, buffer * groups_per_buffer, groups_per_buffer, seed);
+        if constexpr (std::is_same_v<T, float>)
+            random_bits_to_real<float>(words, values_per_buffer, a, b - a, values);
+        else
+        {
+            alignas(64) std::uint64_t bits[values_per_buffer];
+            std::memcpy(bits, words, sizeof(words));
+            if constexpr (std::is_same_v<T, double>)
+                random_bits_to_real<double>(bits, values_per_buffer, a, b - a, values);
+            else
+            {
+                // modulo 2^64, so a full 64-bit range becomes 0, which stands for 2^64
+                const std::uint64_t range = static_cast<std::uint64_t>(b) - static_cast<std::uint64_t>(a) + 1;
+                random_bits_to_range(bits, values_per_buffer, range);
+                for (std::size_t i = 0; i < values_per_buffer; ++i)
+                    values[i] = static_cast<T>(static_cast<std::uint64_t>(a) + bits[i]);
+            }
+        }
     }
-    std::generate(start, last, f);
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
 
+    template<typename Iterator>
+    void operator()(Iterator first, Iterator last, std::size_t offset, T a, T b, std::uint64_t seed)
+    {
+        T values[values_per_buffer];
+        std::size_t remaining = std::distance(first, last);
+        for (std::size_t index = offset; remaining; )
+        {
+            fill_buffer(index / values_per_buffer, a, b, seed, values);
+            const std::size_t skip = index % values_per_buffer;
+            const std::size_t n = std::min(values_per_buffer - skip, remaining);
+            first = std::copy_n(values + skip, n, first);
+            index += n;
+            remaining -= n;
+        }
+    }
+};
+
+template<typename Iterator>
+void generate_random_parallel(Iterator first, Iterator last, typename std::iterator_traits<Iterator>::value_type a,
+    typename std::iterator_traits<Iterator>::value_type b, std::uint64_t seed = 0)
+{
+    using T = typename std::iterator_traits<Iterator>::value_type;
+    const std::size_t length = std::distance(first, last);
+    if (!length)
+        return;
+    PAR_TRACE_CALL("generate_random_parallel", length);
+
+    // whole buffers per block, so no buffer is generated twice
+    const std::size_t per_buffer = random_block<T>::values_per_buffer;
+    const std::size_t grain = (split_grain(length, per_buffer) + per_buffer - 1) / per_buffer * per_buffer;
+
+    split_for(first, length, grain, [a, b, seed](Iterator block_first, Iterator block_last, std::size_t offset)
+    {
+        random_block<T>()(block_first, block_last, offset, a, b, seed);
+    });
 }
 
 
 ///find parallel
+// Lowers best to index unless a lower match is already there
+inline void store_min(std::atomic<std::size_t>& best, std::size_t index)
+{
+    std::size_t current = best.load();
+    while (index < current && !best.compare_exchange_weak(current, index))
+        ;
+}
+
+// A block is scanned in strides of about a page. Before each stride it
+// checks the best index found so far and stops once that lies below the
+// stride, so only blocks above the current best are cancelled and the
+// lowest-index match always wins.
 template<typename Iterator, typename Value>
 struct find_par
 {
-    void operator()(Iterator first, Iterator last, Value val, Iterator& res, std::mutex& mute_iter, std::atomic<bool>& flag)
+    using element_type = typename std::iterator_traits<Iterator>::value_type;
+    static constexpr bool use_simd = is_contiguous_iterator_v<Iterator> && simd_arithmetic_v<element_type>
+        && std::is_same_v<element_type, Value>;
+    static constexpr std::size_t stride = (4096 / sizeof(element_type)) ? 4096 / sizeof(element_type) : 1;
+
+    // index of the first match in [it, it + n) or n; advances it by n
+    std::size_t find_in_stride(Iterator& it, std::size_t n, const Value& val)
     {
-        for (auto it = first; it != last and !flag.load(); ++it)
+        if constexpr (use_simd)
         {
-            if (*it == val)
+            const element_type* data = std::addressof(*it);
+            it += n;
+            return simd_find_first(data, n, val);
+        }
+        else
+        {
+            for (std::size_t i = 0; i < n; ++i, ++it)
+                if (*it == val)
+                    return i;
+            return n;
+        }
+    }
+
+    // false if it stopped before last, at a match here or before
+    bool operator()(Iterator first, Iterator last, std::size_t offset, const Value& val, std::atomic<std::size_t>& best)
+    {
+        const std::size_t length = std::distance(first, last);
+        Iterator it = first;
+        for (std::size_t done = 0; done < length; done += stride)
+        {
+            if (best.load(std::memory_order_relaxed) <= offset + done)
+                return false;
+            const std::size_t n = std::min(stride, length - done);
+            const std::size_t found = find_in_stride(it, n, val);
+            if (found != n)
             {
-                flag.store(true); 
-                if (mute_iter.try_lock())
-                {
-                    res = it;
-                    mute_iter.unlock(); 
-                }
-                return;
-            }    
+                store_min(best, offset + done + found);
+                return false;
+            }
         }
+        return true;
     }
 };
 
@@ -140,152 +755,712 @@ struct find_par
 template<typename Iterator, typename Value>
 Iterator find_parallel(Iterator first, Iterator last, Value val)
 {
-    std::atomic<bool> flag; 
-    std::mutex mute_iter; 
-
     const std::ptrdiff_t length = std::distance(first, last);
     if (!length)
         return last;
 
-    const std::size_t min_per_thread = 50; 
-    const std::size_t max_threads = (length + min_per_thread - 1) / min_per_thread;
-    const std::size_t harware_conc = (std::thread::hardware_concurrency() == 0) ? 2 : std::thread::hardware_concurrency(); 
-    const std::size_t threads_numb = std::min(harware_conc, max_threads); 
+    std::atomic<std::size_t> best(length);
+    split_for_tuned("find_parallel", first, length, [&](Iterator block_first, Iterator block_last, std::size_t offset)
+    {
+        return find_par<Iterator, Value>()(block_first, block_last, offset, val, best);
+    });
+
+    if (best.load() == static_cast<std::size_t>(length))
+        return last;
+    Iterator res = first;
+    std::advance(res, best.load());
+    return res;
+}
 
-    std::vector<std::thread> threads;
-    threads.reserve(threads_numb - 1);
 
-    const std::size_t block_size = length / threads_numb;
-    Iterator res = last; 
-    Iterator start = first;
-    for (size_t i = 0; i < (threads_numb - 1); i++)
+/// === remove_if_parallel / remove_parallel / copy_if_parallel
+// Stream compaction on the ordered tiles of the scan: a tile collects its
+// survivors, publishes their count and learns from the look-back where they
+// go. remove_if_parallel moves the survivors of a tile into a local buffer
+// before publishing the count, and a published prefix means that every tile
+// before it has done the same, so the survivors can go to their final place
+// in the same range right away. Every survivor is read and written once
+// and the order is kept. Elements from the returned end on are left valid
+// but unspecified (moved from), as with std::remove_if.
+template<typename ForwardIt, typename Predicate>
+ForwardIt remove_if_parallel(ForwardIt first, ForwardIt last, Predicate pred)
+{
+    using T = typename std::iterator_traits<ForwardIt>::value_type;
+    using category = typename std::iterator_traits<ForwardIt>::iterator_category;
+
+    if constexpr (!std::is_base_of_v<std::random_access_iterator_tag, category>)
+        return std::remove_if(first, last, pred);
+    else
     {
-        Iterator end = start; 
-        std::advance(end, block_size);
-        threads.emplace_back(find_par<Iterator, Value>(), start, end, val, std::ref(res), std::ref(mute_iter), std::ref(flag));
-        start = end;
-    }
+        const std::size_t length = std::distance(first, last);
+        const std::size_t tiles = (length + scan_tile_size - 1) / scan_tile_size;
+        PAR_TRACE_CALL("remove_if_parallel", length);
+        if (tiles < 2 || thread_pool::instance().size() == 0)
+            return std::remove_if(first, last, pred);
+
+        ordered_tiles<std::size_t> state(tiles);
+        state.run([&](std::size_t t)
+        {
+            const ForwardIt tile_first = first + t * scan_tile_size;
+            const ForwardIt tile_last = first + std::min(length, (t + 1) * scan_tile_size);
+
+            std::vector<T> kept;
+            kept.reserve(tile_last - tile_first);
+            for (ForwardIt it = tile_first; it != tile_last; ++it)
+                if (!pred(*it))
+                    kept.push_back(std::move(*it));
 
-    find_par<Iterator, Value>()( start, last, val, std::ref(res), std::ref(mute_iter), std::ref(flag));
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
-    return (res == last) ? last : res;
+            std::optional<std::size_t> carry;
+            if (!state.publish(t, kept.size(), std::optional<std::size_t>(0), std::plus<>(), carry))
+                return false;
+            std::move(kept.begin(), kept.end(), first + *carry);
+            return true;
+        });
+        return first + state.prefix(tiles - 1);
+    }
 }
 
+template<typename ForwardIt, typename T>
+ForwardIt remove_parallel(ForwardIt first, ForwardIt last, const T& value)
+{
+    return remove_if_parallel(first, last, [&value](const auto& element) { return element == value; });
+}
 
-template <typename Iterator,typename T> 
-void remove_(Iterator first, Iterator last, const T val)
+// The ranges must not overlap. A tile keeps one flag per element, so pred
+// runs once and the elements are read from memory once.
+template<typename InputIt, typename OutputIt, typename Predicate>
+OutputIt copy_if_parallel(InputIt first, InputIt last, OutputIt d_first, Predicate pred)
 {
-    if (first == last)
-        return;
+    using input_category = typename std::iterator_traits<InputIt>::iterator_category;
+    using output_category = typename std::iterator_traits<OutputIt>::iterator_category;
 
-    for (auto it = first, it2 = first; it!=last; ++it) 
+    if constexpr (!std::is_base_of_v<std::random_access_iterator_tag, input_category> || !std::is_base_of_v<std::random_access_iterator_tag, output_category>)
+        return std::copy_if(first, last, d_first, pred);
+    else
     {
-        if (*it != val) 
+        const std::size_t length = std::distance(first, last);
+        const std::size_t tiles = (length + scan_tile_size - 1) / scan_tile_size;
+        PAR_TRACE_CALL("copy_if_parallel", length);
+        if (tiles < 2 || thread_pool::instance().size() == 0)
+            return std::copy_if(first, last, d_first, pred);
+
+        ordered_tiles<std::size_t> state(tiles);
+        state.run([&](std::size_t t)
         {
-            std::iter_swap(it, it2); 
-            ++it2;
-        }
+            const InputIt tile_first = first + t * scan_tile_size;
+            const std::size_t n = std::min(length, (t + 1) * scan_tile_size) - t * scan_tile_size;
+
+            bool keep[scan_tile_size];
+            std::size_t count = 0;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                keep[i] = static_cast<bool>(pred(tile_first[i]));
+                count += keep[i];
+            }
+
+            std::optional<std::size_t> carry;
+            if (!state.publish(t, count, std::optional<std::size_t>(0), std::plus<>(), carry))
+                return false;
+            OutputIt out = d_first + *carry;
+            for (std::size_t i = 0; i < n; ++i)
+                if (keep[i])
+                    *out++ = tile_first[i];
+            return true;
+        });
+        return d_first + state.prefix(tiles - 1);
     }
 }
 
 // find par2
+// Every chunk collects its matches into a buffer of its own; a prefix sum over
+// the chunk counts gives each buffer its place in the output, which is then
+// filled in parallel. No locks, and the result comes out in ascending order.
 template<typename Iterator, typename Value>
 struct find_par2
 {
-    void operator()(Iterator first, Iterator last, const Value val, std::vector<Iterator> & res, std::mutex& mute_iter)
+    template<typename Result, typename Make>
+    void operator()(Iterator first, Iterator last, std::size_t offset, const Value& val, std::vector<Result>& res, const Make& make)
     {
-        for (auto it = first; it != last ; ++it)
+        if constexpr (find_par<Iterator, Value>::use_simd)
         {
-
-            if (*it == val)
-            {
-                std::lock_guard<std::mutex> lock(mute_iter);
-                res.push_back(it); 
-            }
+            const std::size_t n = std::distance(first, last);
+            const auto* data = std::addressof(*first);
+            for (std::size_t i = simd_find_first(data, n, val); i < n; i += 1 + simd_find_first(data + i + 1, n - i - 1, val))
+                res.push_back(make(first + i, offset + i));
+        }
+        else
+        {
+            std::size_t index = offset;
+            for (auto it = first; it != last; ++it, ++index)
+                if (*it == val)
+                    res.push_back(make(it, index));
         }
     }
 };
 
-template<typename Iterator, typename Value>
-std::vector<Iterator> find_parallel2(Iterator first, Iterator last, Value val) 
+// make(iterator, index) turns a match into the stored Result
+template<typename Result, typename Iterator, typename Value, typename Make>
+std::vector<Result> find_all_parallel(Iterator first, Iterator last, const Value& val, const Make& make)
 {
-    std::mutex mute_iter;
-
-    const std::ptrdiff_t length = std::distance(first, last);
+    const std::size_t length = std::distance(first, last);
     if (!length)
         return {};
+    PAR_TRACE_CALL("find_all_parallel", length);
+
+    // Like split_for_tuned, but the blocks after the probe prefix are
+    // counted before the split: their matches go to one vector per chunk
+    auto find_block = [&val, &make](Iterator block_first, Iterator block_last, std::size_t offset, std::vector<Result>& found)
+    {
+        find_par2<Iterator, Value>()(block_first, block_last, offset, val, found, make);
+    };
+    grain_tuner& tuner = grain_tuner::instance();
+    static const std::string key = grain_tuner::key<decltype(find_block)>("find_all_parallel");
+
+    std::vector<Result> head;
+    std::size_t done = 0;
+    if (!tuner.cost(key))
+        done = tuned_probe(key, first, length, [&](Iterator block_first, Iterator block_last, std::size_t offset)
+        {
+            find_block(block_first, block_last, offset, head);
+            return true;
+        }, [](bool complete) { return complete; });
 
-    const std::size_t min_per_thread = 50;
-    const std::size_t max_threads = (length + min_per_thread - 1) / min_per_thread;
-    const std::size_t harware_conc = (std::thread::hardware_concurrency() == 0) ? 2 : std::thread::hardware_concurrency();
-    const std::size_t threads_numb = std::min(harware_conc, max_threads); 
+    const std::size_t rest = length - done;
+    const std::optional<double> cost = tuner.cost(key);
+    const std::size_t grain = std::max<std::size_t>(1, cost ? split_grain(rest, tuner.min_grain(*cost)) : rest);
+    const std::size_t chunks = (rest + grain - 1) / grain;
 
-    std::vector<Iterator> vec_it;
-    vec_it.reserve(threads_numb);
-    std::vector<std::thread> threads;
-    threads.reserve(threads_numb - 1);
+    // split_for cuts on multiples of grain, so every block is exactly one chunk
+    std::vector<std::vector<Result>> local(chunks);
+    if (rest)
+        split_for(first, rest, grain, [&](Iterator block_first, Iterator block_last, std::size_t offset)
+        {
+            find_block(block_first, block_last, offset, local[(offset - done) / grain]);
+        }, done);
 
-    const std::size_t block_size = length / threads_numb;
-    Iterator start = first;
+    std::vector<std::size_t> start(chunks + 1, head.size());
+    for (std::size_t i = 0; i < chunks; ++i)
+        start[i + 1] = start[i] + local[i].size();
 
-    for (size_t i = 0; i < (threads_numb - 1); i++)
+    std::vector<Result> res(start[chunks]);
+    std::copy(head.begin(), head.end(), res.begin());
+    using local_iterator = typename std::vector<std::vector<Result>>::iterator;
+    split_for(local.begin(), chunks, 1, [&](local_iterator block_first, local_iterator block_last, std::size_t chunk)
     {
-        Iterator end = start;
-        std::advance(end, block_size);
-        threads.emplace_back(find_par2<Iterator, Value>(), start, end, val, std::ref(vec_it), std::ref(mute_iter));
-        start = end;
-    }
+        for (; block_first != block_last; ++block_first, ++chunk)
+            std::copy(block_first->begin(), block_first->end(), res.begin() + start[chunk]);
+    });
+    return res;
+}
+
+template<typename Iterator, typename Value>
+std::vector<Iterator> find_parallel2(Iterator first, Iterator last, Value val) 
+{
+    return find_all_parallel<Iterator>(first, last, val, [](Iterator it, std::size_t) { return it; });
+}
+
+// Positions instead of 8-byte iterators: uint32_t halves the output for
+// ranges below 4G elements
+template<typename Index = std::size_t, typename Iterator, typename Value>
+std::vector<Index> find_indices_parallel(Iterator first, Iterator last, Value val)
+{
+    static_assert(std::is_integral_v<Index> && std::is_unsigned_v<Index>, "Index must be an unsigned integer");
+    const std::uint64_t length = std::distance(first, last);
+    if (length != 0 && length - 1 > std::numeric_limits<Index>::max())
+        throw std::length_error("find_indices_parallel: range too long for the index type");
+    return find_all_parallel<Index>(first, last, val, [](Iterator, std::size_t index) { return static_cast<Index>(index); });
+}
+
+// One bit per element (bit i % 64 of word i / 64), for dense matches.
+// Blocks are cut on multiples of 64 elements, so no two write the same word.
+template<typename Iterator, typename Value>
+std::vector<std::uint64_t> find_bitmap_parallel(Iterator first, Iterator last, Value val)
+{
+    const std::size_t length = std::distance(first, last);
+    std::vector<std::uint64_t> bitmap((length + 63) / 64, 0);
+    if (!length)
+        return bitmap;
 
-    find_par2<Iterator, Value>()(start, last, val, std::ref(vec_it), std::ref(mute_iter));
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
-    vec_it.shrink_to_fit();
-    return vec_it; 
+    split_for_tuned("find_bitmap_parallel", first, length, [&](Iterator block_first, Iterator block_last, std::size_t offset)
+    {
+        std::size_t index = offset;
+        for (auto it = block_first; it != block_last; ++it, ++index)
+            if (*it == val)
+                bitmap[index / 64] |= std::uint64_t(1) << (index % 64);
+    }, 64);
+    return bitmap;
 }
 
 
-// max element
+// minmax element
+// One pass for both ends. Ties go to the lowest index for the minimum and
+// the maximum alike (std::minmax_element returns the last maximum).
 template<typename Iterator>
-struct max_element_par
+struct minmax_element_par
 {
-    void operator()(Iterator first, Iterator last, std::vector<Iterator>& res, std::mutex& mute_iter)
+    using element_type = typename std::iterator_traits<Iterator>::value_type;
+
+    std::pair<Iterator, Iterator> operator()(Iterator first, Iterator last)
     {
-        auto it = std::max_element(first, last); 
-        std::lock_guard<std::mutex> lock(mute_iter);
-        res.push_back(it);
+        if constexpr (is_contiguous_iterator_v<Iterator> && simd_ordered_v<element_type>)
+        {
+            const std::pair<std::size_t, std::size_t> res = simd_minmax_index(std::addressof(*first), std::distance(first, last));
+            return { first + res.first, first + res.second };
+        }
+        else
+        {
+            Iterator min_it = first;
+            Iterator max_it = first;
+            for (Iterator it = std::next(first); it != last; ++it)
+            {
+                if (*it < *min_it)
+                    min_it = it;
+                if (*max_it < *it)
+                    max_it = it;
+            }
+            return { min_it, max_it };
+        }
     }
-    
 };
 
+// {min, max}; {last, last} for an empty range
 template <typename Iterator>
-Iterator max_element_parallel(Iterator first, Iterator last)
+std::pair<Iterator, Iterator> minmax_element_parallel(Iterator first, Iterator last)
 {
     const std::ptrdiff_t length = std::distance(first, last); 
     if (!length)
-        return last;
+        return { last, last };
+
+    // the left block wins ties on both ends
+    return split_reduce_tuned("minmax_element_parallel", first, length,
+        [](Iterator block_first, Iterator block_last, std::size_t) { return minmax_element_par<Iterator>()(block_first, block_last); },
+        [](std::pair<Iterator, Iterator> left, std::pair<Iterator, Iterator> right)
+        {
+            return std::pair<Iterator, Iterator>((*right.first < *left.first) ? right.first : left.first,
+                                                 (*left.second < *right.second) ? right.second : left.second);
+        });
+}
+
+template <typename Iterator>
+Iterator max_element_parallel(Iterator first, Iterator last)
+{
+    return minmax_element_parallel(first, last).second;
+}
+
+template <typename Iterator>
+Iterator min_element_parallel(Iterator first, Iterator last)
+{
+    return minmax_element_parallel(first, last).first;
+}
+
+
+/// === sort_parallel
+// Sample sort: splitters taken from a sorted random sample cut the value
+// range into buckets of about equal size. Every element is classified once
+// (the bucket number is kept in one byte per element), the elements are
+// moved into a buffer bucket by bucket, and the buckets are sorted and moved
+// back in parallel. Elements equal to a splitter get a bucket of their own
+// that needs no sorting, so duplicates cannot pile up in one bucket.
+// Integral keys in the default order go through an LSD radix sort instead.
+// The buffer is raw storage the elements are move-constructed into, so T
+// needs no default constructor. If the comparator throws, every bucket
+// still in the buffer is moved back before the exception leaves, so the
+// range keeps its elements in unspecified order, losing no more than the
+// std:: algorithm that threw while sorting a bucket loses of it on its own
+// (std::sort the element its insertion sort holds, std::stable_sort
+// possibly more).
+// Types that can't be copied (the splitters are copies) or whose moves may
+// throw use the std:: algorithm, as do ranges below sort_serial_cutoff and
+// calls on a pool without workers. The radix path and the pivot path of
+// partial_sort_parallel run there too, serially on the calling thread.
+std::size_t const sort_serial_cutoff = 1 << 14;
+
+template<typename RandomIt, typename Compare>
+class sample_sort
+{
+private:
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+
+    // buckets() must fit the one-byte classification
+    static constexpr std::size_t max_splitters = 127;
+    static constexpr std::size_t oversampling = 16;
+
+    RandomIt first;
+    std::size_t length;
+    Compare comp;
+    // length elements, constructed by partition() and destroyed with it
+    struct element_buffer
+    {
+        std::allocator<T> alloc;
+        T* data = nullptr;
+        std::size_t size = 0;
+
+        element_buffer() = default;
+        element_buffer(const element_buffer&) = delete;
+        element_buffer& operator=(const element_buffer&) = delete;
+
+        ~element_buffer()
+        {
+            if (data)
+            {
+                std::destroy_n(data, size);
+                alloc.deallocate(data, size);
+            }
+        }
+    };
+
+    std::vector<T> splitters;
+    element_buffer buffer;
+    std::vector<std::size_t> bucket_start;
+
+    std::size_t buckets() const
+    {
+        return 2 * splitters.size() + 1;
+    }
+
+    // 2k between splitters[k - 1] and splitters[k], 2k - 1 for an element
+    // equal to splitters[k - 1]
+    std::size_t classify(const T& value) const
+    {
+        const std::size_t k = std::upper_bound(splitters.begin(), splitters.end(), value, comp) - splitters.begin();
+        return (k > 0 && !comp(splitters[k - 1], value)) ? 2 * k - 1 : 2 * k;
+    }
+
+    void choose_splitters()
+    {
+        const std::size_t wanted = std::min(max_splitters, 4 * (thread_pool::instance().size() + 1) - 1);
+        // fixed seed: the same input always gives the same buckets
+        std::minstd_rand eng(1);
+        std::uniform_int_distribution<std::size_t> position(0, length - 1);
+        std::vector<T> sample;
+        sample.reserve((wanted + 1) * oversampling);
+        for (std::size_t i = 0; i < (wanted + 1) * oversampling; ++i)
+            sample.push_back(first[position(eng)]);
+        std::sort(sample.begin(), sample.end(), comp);
+
+        for (std::size_t i = 1; i <= wanted; ++i)
+        {
+            const T& candidate = sample[i * oversampling];
+            if (splitters.empty() || comp(splitters.back(), candidate))
+                splitters.push_back(candidate);
+        }
+    }
+
+    // Moves the elements into buffer, ordered by bucket; elements of one
+    // bucket keep their relative order
+    void partition()
+    {
+        const std::size_t grain = split_grain(length, sort_serial_cutoff);
+        const std::size_t chunks = (length + grain - 1) / grain;
+        const std::size_t bucket_count = buckets();
+
+        std::unique_ptr<std::uint8_t[]> oracle(new std::uint8_t[length]);
+        std::vector<std::size_t> counts(chunks * bucket_count, 0);
+        split_for(first, length, grain, [&](RandomIt block_first, RandomIt block_last, std::size_t offset)
+        {
+            std::size_t* count = counts.data() + offset / grain * bucket_count;
+            for (std::size_t i = offset; block_first != block_last; ++block_first, ++i)
+            {
+                const std::size_t bucket = classify(*block_first);
+                oracle[i] = static_cast<std::uint8_t>(bucket);
+                ++count[bucket];
+            }
+        });
+
+        // bucket b of chunk c goes after all smaller buckets and after
+        // bucket b of the chunks before c
+        bucket_start.assign(bucket_count + 1, 0);
+        std::size_t position = 0;
+        for (std::size_t b = 0; b < bucket_count; ++b)
+        {
+            bucket_start[b] = position;
+            for (std::size_t c = 0; c < chunks; ++c)
+            {
+                const std::size_t n = counts[c * bucket_count + b];
+                counts[c * bucket_count + b] = position;
+                position += n;
+            }
+        }
+        bucket_start[bucket_count] = position;
+
+        // every slot is constructed exactly once and none of that can throw
+        T* const storage = buffer.alloc.allocate(length);
+        split_for(first, length, grain, [&](RandomIt block_first, RandomIt block_last, std::size_t offset)
+        {
+            std::size_t* next = counts.data() + offset / grain * bucket_count;
+            for (std::size_t i = offset; block_first != block_last; ++block_first, ++i)
+                ::new (static_cast<void*>(storage + next[oracle[i]]++)) T(std::move(*block_first));
+        });
+        buffer.data = storage;
+        buffer.size = length;
+    }
+
+    // Sorts the buckets that hold a part of the first k positions and moves
+    // every bucket back, also the ones left in the buffer when one throws
+    template<bool stable>
+    void sort_buckets(std::size_t k)
+    {
+        using start_iterator = std::vector<std::size_t>::iterator;
+        std::vector<std::uint8_t> moved_back(buckets(), 0);
+        try
+        {
+            split_for(bucket_start.begin(), buckets(), 1, [&](start_iterator, start_iterator, std::size_t bucket)
+            {
+                T* bucket_first = buffer.data + bucket_start[bucket];
+                T* bucket_last = buffer.data + bucket_start[bucket + 1];
+                // odd buckets hold elements equal to a splitter
+                if (bucket % 2 == 0 && bucket_start[bucket] < k)
+                {
+                    if (bucket_start[bucket + 1] > k)
+                        std::partial_sort(bucket_first, buffer.data + k, bucket_last, comp);
+                    else if constexpr (stable)
+                        std::stable_sort(bucket_first, bucket_last, comp);
+                    else
+                        std::sort(bucket_first, bucket_last, comp);
+                }
+                std::move(bucket_first, bucket_last, first + bucket_start[bucket]);
+                moved_back[bucket] = 1;
+            });
+        }
+        catch (...)
+        {
+            // split_for has joined every task
+            for (std::size_t bucket = 0; bucket < buckets(); ++bucket)
+                if (!moved_back[bucket])
+                    std::move(buffer.data + bucket_start[bucket], buffer.data + bucket_start[bucket + 1], first + bucket_start[bucket]);
+            throw;
+        }
+    }
 
-    std::mutex mute_iter; 
-    const size_t min_per_thread = 50; 
-    const size_t max_thread = (length + min_per_thread - 1) / min_per_thread; 
-    const size_t hardware_conc = std::thread::hardware_concurrency();   
-    const size_t numb_threads = std::min((hardware_conc == 0) ? 2 : hardware_conc, max_thread); 
-    const size_t size_block = length / numb_threads;
+public:
+    // the splitters are copies, and the elements must move into the buffer
+    // and back without a way to fail halfway
+    static constexpr bool usable = std::is_copy_constructible_v<T>
+        && std::is_nothrow_move_constructible_v<T> && std::is_nothrow_move_assignable_v<T>;
 
-    std::vector<Iterator> results;   
-    results.reserve(numb_threads);  
-     
-    std::vector<std::thread> threads(numb_threads - 1); // --> 1 for main thread;
-    Iterator start = first;
-    for (size_t i = 0; i < (numb_threads - 1); i++) 
+    sample_sort(RandomIt first_, std::size_t length_, Compare comp_) : first(first_), length(length_), comp(comp_)
+    {}
+
+    // The first k positions end up sorted
+    template<bool stable>
+    void run(std::size_t k)
+    {
+        choose_splitters();
+        partition();
+        sort_buckets<stable>(k);
+    }
+};
+
+// LSD radix sort on bytes, a pass per byte. Every pass counts the digits per
+// chunk and scatters the chunks in order into the other buffer, so each pass
+// is stable; a pass whose digit is the same for every element is skipped
+// (values below 2^31 in 64-bit keys cost four passes, not eight). Signed keys
+// get their sign bit flipped so that negative numbers sort first.
+template<typename T>
+void radix_sort_parallel(T* data, std::size_t length)
+{
+    using U = std::make_unsigned_t<T>;
+    constexpr U flip = std::is_signed_v<T> ? U(U(1) << (sizeof(T) * 8 - 1)) : U(0);
+    constexpr std::size_t radix = 256;
+
+    const std::size_t grain = split_grain(length, sort_serial_cutoff);
+    const std::size_t chunks = (length + grain - 1) / grain;
+    std::unique_ptr<T[]> buffer(new T[length]);
+    std::vector<std::size_t> counts(chunks * radix);
+    T* src = data;
+    T* dst = buffer.get();
+
+    for (unsigned shift = 0; shift < sizeof(T) * 8; shift += 8)
     {
-        Iterator end = start;  
-        std::advance(end, size_block); 
-        threads[i] = std::thread(max_element_par<Iterator>(), start, end, std::ref(results), std::ref(mute_iter));
-        start = end;
+        auto digit = [shift](T value) { return (static_cast<U>(static_cast<U>(value) ^ flip) >> shift) & 0xFF; };
+
+        std::fill(counts.begin(), counts.end(), 0);
+        split_for(src, length, grain, [&](T* block_first, T* block_last, std::size_t offset)
+        {
+            std::size_t* count = counts.data() + offset / grain * radix;
+            for (; block_first != block_last; ++block_first)
+                ++count[digit(*block_first)];
+        });
+
+        bool one_digit = false;
+        std::size_t position = 0;
+        for (std::size_t d = 0; d < radix; ++d)
+        {
+            const std::size_t digit_start = position;
+            for (std::size_t c = 0; c < chunks; ++c)
+            {
+                const std::size_t n = counts[c * radix + d];
+                counts[c * radix + d] = position;
+                position += n;
+            }
+            one_digit = one_digit || position - digit_start == length;
+        }
+        if (one_digit)
+            continue;
+
+        split_for(src, length, grain, [&](T* block_first, T* block_last, std::size_t offset)
+        {
+            std::size_t* next = counts.data() + offset / grain * radix;
+            for (; block_first != block_last; ++block_first)
+                dst[next[digit(*block_first)]++] = *block_first;
+        });
+        std::swap(src, dst);
     }
-    max_element_par<Iterator>()(start, last, std::ref(results),std::ref(mute_iter));  
-    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));   
-    auto res = std::max_element(results.begin(), results.end());   
-    return *res; 
+
+    if (src != data)
+        split_for(src, length, grain, [data](T* block_first, T* block_last, std::size_t offset)
+        {
+            std::copy(block_first, block_last, data + offset);
+        });
+}
+
+template<typename RandomIt, typename Compare>
+constexpr bool use_radix_sort_v = is_contiguous_iterator_v<RandomIt>
+    && std::is_integral_v<typename std::iterator_traits<RandomIt>::value_type>
+    && !std::is_same_v<typename std::iterator_traits<RandomIt>::value_type, bool>
+    && (std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::less<typename std::iterator_traits<RandomIt>::value_type>>);
+
+template<typename RandomIt, typename Compare = std::less<>>
+void sort_parallel(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+    static_assert(std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<RandomIt>::iterator_category>,
+        "sort_parallel needs random access iterators");
+    const std::size_t length = std::distance(first, last);
+    PAR_TRACE_CALL("sort_parallel", length);
+    if (length < sort_serial_cutoff)
+        std::sort(first, last, comp);
+    else if constexpr (use_radix_sort_v<RandomIt, Compare>)
+        radix_sort_parallel(std::addressof(*first), length);
+    else if constexpr (!sample_sort<RandomIt, Compare>::usable)
+        std::sort(first, last, comp);
+    else if (thread_pool::instance().size() == 0)
+        std::sort(first, last, comp);
+    else
+        sample_sort<RandomIt, Compare>(first, length, comp).template run<false>(length);
 }
 
+// Equal elements keep their order: the buckets are filled in input order and
+// sorted with std::stable_sort (radix sort is stable anyway)
+template<typename RandomIt, typename Compare = std::less<>>
+void stable_sort_parallel(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+    static_assert(std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<RandomIt>::iterator_category>,
+        "stable_sort_parallel needs random access iterators");
+    const std::size_t length = std::distance(first, last);
+    PAR_TRACE_CALL("stable_sort_parallel", length);
+    if (length < sort_serial_cutoff)
+        std::stable_sort(first, last, comp);
+    else if constexpr (use_radix_sort_v<RandomIt, Compare>)
+        radix_sort_parallel(std::addressof(*first), length);
+    else if constexpr (!sample_sort<RandomIt, Compare>::usable)
+        std::stable_sort(first, last, comp);
+    else if (thread_pool::instance().size() == 0)
+        std::stable_sort(first, last, comp);
+    else
+        sample_sort<RandomIt, Compare>(first, length, comp).template run<true>(length);
+}
+
+// Positions of the elements in [first, first + length) that satisfy pred,
+// ascending; offset is added to every position
+template<typename RandomIt, typename Predicate>
+std::vector<std::size_t> positions_if_parallel(RandomIt first, std::size_t length, std::size_t offset, const Predicate& pred)
+{
+    if (!length)
+        return {};
+    const std::size_t grain = split_grain(length, sort_serial_cutoff);
+    const std::size_t chunks = (length + grain - 1) / grain;
+
+    std::vector<std::vector<std::size_t>> local(chunks);
+    split_for(first, length, grain, [&](RandomIt block_first, RandomIt block_last, std::size_t block_offset)
+    {
+        std::vector<std::size_t>& found = local[block_offset / grain];
+        for (std::size_t i = offset + block_offset; block_first != block_last; ++block_first, ++i)
+            if (pred(*block_first))
+                found.push_back(i);
+    });
+
+    std::vector<std::size_t> res;
+    for (const std::vector<std::size_t>& found : local)
+        res.insert(res.end(), found.begin(), found.end());
+    return res;
+}
+
+// partial_sort_parallel for a small k: a pivot from a sample that very
+// likely has a little more than k elements below it; the elements below it
+// are swapped to the front and only they are sorted. Two reading passes
+// instead of moving the whole range through the buckets. Returns false,
+// with the range unchanged, if fewer than k elements lie below the pivot.
+template<typename RandomIt, typename Compare>
+bool partial_sort_by_pivot(RandomIt first, std::size_t length, std::size_t k, Compare comp)
+{
+    using T = typename std::iterator_traits<RandomIt>::value_type;
+    const std::size_t sample_size = 16384;
+
+    std::minstd_rand eng(1);
+    std::uniform_int_distribution<std::size_t> position(0, length - 1);
+    std::vector<T> sample;
+    sample.reserve(sample_size);
+    for (std::size_t i = 0; i < sample_size; ++i)
+        sample.push_back(first[position(eng)]);
+
+    // expected rank of the k-th element in the sample plus about three
+    // standard deviations
+    const double rank = static_cast<double>(k) * sample_size / length;
+    const std::size_t pivot_rank = static_cast<std::size_t>(rank + 3 * std::sqrt(rank) + 8);
+    if (pivot_rank >= sample_size)
+        return false;
+    std::nth_element(sample.begin(), sample.begin() + pivot_rank, sample.end(), comp);
+    const T pivot = sample[pivot_rank];
+    auto below = [&pivot, &comp](const T& value) { return comp(value, pivot); };
+
+    const std::size_t grain = split_grain(length, sort_serial_cutoff);
+    const std::size_t front = split_reduce(first, length, grain,
+        [&below](RandomIt block_first, RandomIt block_last, std::size_t) { return static_cast<std::size_t>(std::count_if(block_first, block_last, below)); },
+        [](std::size_t left, std::size_t right) { return left + right; });
+    if (front < k)
+        return false;
+
+    // as many elements not below the pivot in [0, front) as there are below it in [front, length)
+    const std::vector<std::size_t> out = positions_if_parallel(first, front, 0, [&below](const T& value) { return !below(value); });
+    const std::vector<std::size_t> in = positions_if_parallel(first + front, length - front, front, below);
+    using position_iterator = std::vector<std::size_t>::const_iterator;
+    if (!out.empty())
+        split_for(out.begin(), out.size(), split_grain(out.size(), sort_serial_cutoff), [&](position_iterator block_first, position_iterator block_last, std::size_t offset)
+        {
+            for (position_iterator it = in.begin() + offset; block_first != block_last; ++block_first, ++it)
+                std::iter_swap(first + *block_first, first + *it);
+        });
+
+    sort_parallel(first, first + front, comp);
+    return true;
+}
+
+// [first, middle) gets the smallest elements in order, the rest is left in
+// unspecified order. A small middle - first goes through a sampled pivot,
+// otherwise only the sample sort buckets reaching into [first, middle) are
+// sorted.
+template<typename RandomIt, typename Compare = std::less<>>
+void partial_sort_parallel(RandomIt first, RandomIt middle, RandomIt last, Compare comp = Compare())
+{
+    static_assert(std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<RandomIt>::iterator_category>,
+        "partial_sort_parallel needs random access iterators");
+    const std::size_t length = std::distance(first, last);
+    const std::size_t k = std::distance(first, middle);
+    if (k == 0)
+        return;
+    PAR_TRACE_CALL("partial_sort_parallel", length);
+    // the pivot path copies its sample and pivot
+    if (length < sort_serial_cutoff)
+        std::partial_sort(first, middle, last, comp);
+    else if constexpr (!std::is_copy_constructible_v<typename std::iterator_traits<RandomIt>::value_type>)
+        std::partial_sort(first, middle, last, comp);
+    else if (k <= length / 4 && partial_sort_by_pivot(first, length, k, comp))
+        return;
+    else if constexpr (!sample_sort<RandomIt, Compare>::usable)
+        std::partial_sort(first, middle, last, comp);
+    else if (thread_pool::instance().size() == 0)
+        std::partial_sort(first, middle, last, comp);
+    else
+        sample_sort<RandomIt, Compare>(first, length, comp).template run<false>(k);
+}
 
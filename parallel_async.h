@@ -0,0 +1,423 @@
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "parallel_async.h needs C++20 coroutines"
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "parallel_alghr.h"
+
+
+/// === par_future
+// Handle to a result computed on the shared pool. It works like a
+// std::future (get, wait, wait_for, valid, ready), except that get/wait
+// help with queued work instead of blocking, and it can be co_awaited:
+// the awaiting coroutine is suspended and resumed on the thread that
+// finishes the work, so the caller is free in between.
+// par_future<T> is also a coroutine return type. Such a coroutine starts
+// eagerly on the calling thread and runs until its first co_await of an
+// unfinished par_future.
+// A par_future is awaited (or get() is called) once, like std::future.
+// Without a state (default-constructed, moved from, or after get) ready()
+// is false, and wait, wait_for, get and co_await throw
+// std::future_error(std::future_errc::no_state).
+template<typename T>
+class par_future;
+
+// Resumes at most one coroutine once the result is set. continuation holds
+// nullptr, the suspended coroutine, or the state itself when done.
+struct par_completion
+{
+    std::atomic<void*> continuation{ nullptr };
+
+    bool done() const
+    {
+        return continuation.load(std::memory_order_acquire) == this;
+    }
+
+    // false when the result is already there and h must not be suspended
+    bool suspend(std::coroutine_handle<> h)
+    {
+        void* expected = nullptr;
+        return continuation.compare_exchange_strong(expected, h.address(), std::memory_order_acq_rel);
+    }
+
+    void finish()
+    {
+        void* waiting = continuation.exchange(this, std::memory_order_acq_rel);
+        if (waiting)
+            std::coroutine_handle<>::from_address(waiting).resume();
+    }
+};
+
+template<typename T>
+struct par_promise_base
+{
+    std::promise<T> result;
+    std::shared_ptr<par_completion> completion = std::make_shared<par_completion>();
+
+    void unhandled_exception()
+    {
+        result.set_exception(std::current_exception());
+    }
+};
+
+template<typename T>
+struct par_promise_return : par_promise_base<T>
+{
+    template<typename U = T>
+    void return_value(U&& value)
+    {
+        this->result.set_value(std::forward<U>(value));
+    }
+};
+
+template<>
+struct par_promise_return<void> : par_promise_base<void>
+{
+    void return_void()
+    {
+        result.set_value();
+    }
+};
+
+template<typename T>
+class par_future
+{
+private:
+    std::future<T> fut;
+    std::shared_ptr<par_completion> completion;
+
+    void check_state() const
+    {
+        if (!completion || !fut.valid())
+            throw std::future_error(std::future_errc::no_state);
+    }
+
+public:
+    struct promise_type : par_promise_return<T>
+    {
+        par_future get_return_object()
+        {
+            return par_future(this->result.get_future(), this->completion);
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        // The frame is destroyed before the awaiting coroutine is resumed
+        struct final_awaiter
+        {
+            bool await_ready() noexcept
+            {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                std::shared_ptr<par_completion> completion = std::move(h.promise().completion);
+                h.destroy();
+                completion->finish();
+            }
+            void await_resume() noexcept
+            {}
+        };
+
+        final_awaiter final_suspend() noexcept
+        {
+            return {};
+        }
+    };
+
+    par_future() = default;
+    par_future(std::future<T> fut_, std::shared_ptr<par_completion> completion_)
+        : fut(std::move(fut_)), completion(std::move(completion_))
+    {}
+
+    bool valid() const
+    {
+        return fut.valid();
+    }
+
+    bool ready() const
+    {
+        return completion && fut.valid() && completion->done();
+    }
+
+    void wait() const
+    {
+        check_state();
+        thread_pool::instance().wait(fut);
+    }
+
+    template<typename Rep, typename Period>
+    std::future_status wait_for(const std::chrono::duration<Rep, Period>& timeout) const
+    {
+        check_state();
+        return fut.wait_for(timeout);
+    }
+
+    T get()
+    {
+        check_state();
+        return thread_pool::instance().get(fut);
+    }
+
+    // Plain std::future for code that does not know about the pool
+    std::future<T> to_future() &&
+    {
+        return std::move(fut);
+    }
+
+    bool await_ready() const
+    {
+        check_state();
+        return completion->done();
+    }
+
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        return completion->suspend(h);
+    }
+
+    T await_resume()
+    {
+        return fut.get();
+    }
+};
+
+
+/// === async_parallel
+// Runs f() on the shared pool and returns at once. With no pool workers
+// (thread_pool::set_size(0)) nothing would pick the task up, so f runs on
+// the calling thread and the returned par_future is already ready.
+// The ranges handed to the async_* functions below must stay alive and
+// untouched until the result has been awaited.
+template<typename Func>
+par_future<std::invoke_result_t<Func>> async_parallel(Func f)
+{
+    using result_type = std::invoke_result_t<Func>;
+    auto result = std::make_shared<std::promise<result_type>>();
+    auto completion = std::make_shared<par_completion>();
+    par_future<result_type> handle(result->get_future(), completion);
+
+    auto run = [f = std::move(f), result, completion]() mutable
+    {
+        try
+        {
+            if constexpr (std::is_void_v<result_type>)
+            {
+                f();
+                result->set_value();
+            }
+            else
+            {
+                result->set_value(f());
+            }
+        }
+        catch (...)
+        {
+            result->set_exception(std::current_exception());
+        }
+        completion->finish();
+    };
+
+    thread_pool& pool = thread_pool::instance();
+    if (pool.size() == 0)
+        run();
+    else
+        pool.submit(std::move(run));
+    return handle;
+}
+
+
+/// === async_* algorithms
+template<typename Iterator, typename T>
+par_future<T> async_accumulate(Iterator first, Iterator last, T init)
+{
+    return async_parallel([=] { return accumulate_parallel(first, last, init); });
+}
+
+template<typename Iterator, typename T>
+par_future<T> async_accumulate_reproducible(Iterator first, Iterator last, T init)
+{
+    return async_parallel([=] { return accumulate_parallel_reproducible(first, last, init); });
+}
+
+template<typename InputIt, typename OutputIt, typename UnaryOperation>
+par_future<void> async_transform(InputIt first, InputIt last, OutputIt d_first, UnaryOperation op)
+{
+    return async_parallel([=] { transform_parallel(first, last, d_first, op); });
+}
+
+template<typename Iterator>
+par_future<void> async_generate_random(Iterator first, Iterator last, typename std::iterator_traits<Iterator>::value_type a,
+    typename std::iterator_traits<Iterator>::value_type b, std::uint64_t seed = 0)
+{
+    return async_parallel([=] { generate_random_parallel(first, last, a, b, seed); });
+}
+
+template<typename Iterator, typename Value>
+par_future<Iterator> async_find(Iterator first, Iterator last, Value val)
+{
+    return async_parallel([=] { return find_parallel(first, last, val); });
+}
+
+template<typename Index = std::size_t, typename Iterator, typename Value>
+par_future<std::vector<Index>> async_find_indices(Iterator first, Iterator last, Value val)
+{
+    return async_parallel([=] { return find_indices_parallel<Index>(first, last, val); });
+}
+
+template<typename Iterator>
+par_future<std::pair<Iterator, Iterator>> async_minmax_element(Iterator first, Iterator last)
+{
+    return async_parallel([=] { return minmax_element_parallel(first, last); });
+}
+
+template<typename InputIt, typename OutputIt>
+par_future<OutputIt> async_inclusive_scan(InputIt first, InputIt last, OutputIt d_first)
+{
+    return async_parallel([=] { return inclusive_scan_parallel(first, last, d_first); });
+}
+
+template<typename InputIt, typename OutputIt, typename T>
+par_future<OutputIt> async_exclusive_scan(InputIt first, InputIt last, OutputIt d_first, T init)
+{
+    return async_parallel([=] { return exclusive_scan_parallel(first, last, d_first, init); });
+}
+
+template<typename ForwardIt, typename Predicate>
+par_future<ForwardIt> async_remove_if(ForwardIt first, ForwardIt last, Predicate pred)
+{
+    return async_parallel([=] { return remove_if_parallel(first, last, pred); });
+}
+
+template<typename InputIt, typename OutputIt, typename Predicate>
+par_future<OutputIt> async_copy_if(InputIt first, InputIt last, OutputIt d_first, Predicate pred)
+{
+    return async_parallel([=] { return copy_if_parallel(first, last, d_first, pred); });
+}
+
+template<typename RandomIt, typename Compare = std::less<>>
+par_future<void> async_sort(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+    return async_parallel([=] { sort_parallel(first, last, comp); });
+}
+
+template<typename RandomIt, typename Compare = std::less<>>
+par_future<void> async_stable_sort(RandomIt first, RandomIt last, Compare comp = Compare())
+{
+    return async_parallel([=] { stable_sort_parallel(first, last, comp); });
+}
+
+
+/// === when_all
+// co_await when_all(a, b, c) gives a std::tuple of the results; a
+// par_future<void> contributes a std::monostate. The futures are already
+// running, they are only awaited one after the other. The vector form
+// gives a std::vector of the results (nothing for void).
+// The first exception is rethrown after every future has been awaited.
+template<typename T>
+struct when_all_value
+{
+    using type = T;
+};
+
+template<>
+struct when_all_value<void>
+{
+    using type = std::monostate;
+};
+
+template<typename T>
+using when_all_value_t = typename when_all_value<T>::type;
+
+template<typename T>
+par_future<when_all_value_t<T>> when_all_settle(par_future<T> f, std::exception_ptr& error)
+{
+    try
+    {
+        if constexpr (std::is_void_v<T>)
+        {
+            co_await f;
+            co_return std::monostate();
+        }
+        else
+        {
+            co_return co_await f;
+        }
+    }
+    catch (...)
+    {
+        if (!error)
+            error = std::current_exception();
+    }
+    co_return when_all_value_t<T>();
+}
+
+template<typename... Ts>
+par_future<std::tuple<when_all_value_t<Ts>...>> when_all(par_future<Ts>... futures)
+{
+    static_assert((std::is_default_constructible_v<when_all_value_t<Ts>> && ...),
+        "when_all needs default-constructible results to survive an exception");
+    std::exception_ptr error;
+    // braced init: awaited left to right
+    std::tuple<when_all_value_t<Ts>...> results{ co_await when_all_settle(std::move(futures), error)... };
+    if (error)
+        std::rethrow_exception(error);
+    co_return results;
+}
+
+template<typename T>
+par_future<std::vector<T>> when_all(std::vector<par_future<T>> futures)
+{
+    std::exception_ptr error;
+    std::vector<T> results;
+    results.reserve(futures.size());
+    for (par_future<T>& f : futures)
+    {
+        try
+        {
+            results.push_back(co_await f);
+        }
+        catch (...)
+        {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+    co_return results;
+}
+
+inline par_future<void> when_all(std::vector<par_future<void>> futures)
+{
+    std::exception_ptr error;
+    for (par_future<void>& f : futures)
+    {
+        try
+        {
+            co_await f;
+        }
+        catch (...)
+        {
+            if (!error)
+                error = std::current_exception();
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
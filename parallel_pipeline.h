@@ -0,0 +1,296 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "parallel_alghr.h"
+
+
+/// === lazy fused pipelines
+// par_view(v) | par::map(f) | par::map(g) | par::filter(p) | par::reduce(init, op)
+// Stages are only recorded until a terminal (reduce, to) is attached. The
+// terminal then runs the whole chain in one split_reduce/split_for pass:
+// every leaf pushes each source element through all stages and folds or
+// stores it, so no intermediate vector is ever materialized and the data
+// is read from memory once.
+//
+// The stage objects live in namespace par, so they do not clash with
+// std::map/std::reduce under "using namespace std".
+
+template<typename Iterator, typename... Stages>
+class par_pipeline
+{
+private:
+    template<typename T, typename... Rest>
+    struct result_of_stages
+    {
+        using type = T;
+    };
+
+    template<typename T, typename Stage, typename... Rest>
+    struct result_of_stages<T, Stage, Rest...>
+    {
+        using type = typename result_of_stages<typename Stage::template result_type<T>, Rest...>::type;
+    };
+
+public:
+    using source_type = typename std::iterator_traits<Iterator>::value_type;
+    // Type an element has after the last stage
+    using value_type = typename result_of_stages<source_type, Stages...>::type;
+    static constexpr bool filters = (false || ... || Stages::filters);
+
+    Iterator first;
+    Iterator last;
+    std::tuple<Stages...> stages;
+
+    par_pipeline(Iterator first_, Iterator last_, std::tuple<Stages...> stages_ = {})
+        : first(first_), last(last_), stages(std::move(stages_))
+    {}
+
+    template<typename Stage>
+    par_pipeline<Iterator, Stages..., Stage> then(Stage stage) const
+    {
+        return par_pipeline<Iterator, Stages..., Stage>(first, last, std::tuple_cat(stages, std::make_tuple(std::move(stage))));
+    }
+
+    // Wraps sink(value) into the callable that runs stage I..end on a source element
+    template<std::size_t I = 0, typename Sink>
+    auto make_sink(Sink sink) const
+    {
+        if constexpr (I == sizeof...(Stages))
+            return sink;
+        else
+            return std::get<I>(stages).wrap(make_sink<I + 1>(std::move(sink)));
+    }
+};
+
+template<typename Iterator>
+par_pipeline<Iterator> par_view(Iterator first, Iterator last)
+{
+    return par_pipeline<Iterator>(first, last);
+}
+
+template<typename Range>
+auto par_view(Range& range) -> par_pipeline<decltype(std::begin(range))>
+{
+    return par_view(std::begin(range), std::end(range));
+}
+
+
+namespace par
+{
+
+/// === stages
+template<typename F>
+struct map_stage
+{
+    static constexpr bool is_stage = true;
+    static constexpr bool filters = false;
+    template<typename T>
+    using result_type = std::decay_t<std::invoke_result_t<const F&, const T&>>;
+
+    F f;
+
+    template<typename Sink>
+    auto wrap(Sink sink) const
+    {
+        return [&f = f, sink](const auto& value) { sink(f(value)); };
+    }
+};
+
+template<typename Predicate>
+struct filter_stage
+{
+    static constexpr bool is_stage = true;
+    static constexpr bool filters = true;
+    template<typename T>
+    using result_type = T;
+
+    Predicate p;
+
+    template<typename Sink>
+    auto wrap(Sink sink) const
+    {
+        return [&p = p, sink](const auto& value)
+        {
+            if (p(value))
+                sink(value);
+        };
+    }
+};
+
+template<typename F>
+map_stage<std::decay_t<F>> map(F&& f)
+{
+    return { std::forward<F>(f) };
+}
+
+template<typename Predicate>
+filter_stage<std::decay_t<Predicate>> filter(Predicate&& p)
+{
+    return { std::forward<Predicate>(p) };
+}
+
+
+/// === terminals
+// Folds the elements left after the last stage with op, which has to be
+// associative. Every block folds its own elements in order and the blocks
+// are combined left to right, so op need not be commutative.
+struct no_init
+{};
+
+template<typename T, typename Op>
+struct reduce_stage
+{
+    static constexpr bool is_terminal = true;
+
+    T init;
+    Op op;
+
+    template<typename Iterator, typename... Stages>
+    auto operator()(const par_pipeline<Iterator, Stages...>& p) const
+    {
+        using pipeline = par_pipeline<Iterator, Stages...>;
+        using R = std::conditional_t<std::is_same_v<T, no_init>, typename pipeline::value_type, T>;
+        using partial = std::optional<R>;
+
+        const std::size_t length = std::distance(p.first, p.last);
+        if (!length)
+            return result<R>(partial());
+
+        const Op& fold_op = op;
+
+        const partial total = split_reduce_tuned("par::reduce", p.first, length,
+            [&p, &fold_op](Iterator block_first, Iterator block_last, std::size_t)
+            {
+                // the first surviving element seeds the block, the rest are
+                // folded without testing for an empty accumulator
+                partial acc;
+                auto seed = p.make_sink([&acc](const auto& value) { acc.emplace(value); });
+                for (; block_first != block_last && !acc; ++block_first)
+                    seed(*block_first);
+                auto fold = p.make_sink([&acc, &fold_op](const auto& value) { *acc = fold_op(std::move(*acc), value); });
+                for (; block_first != block_last; ++block_first)
+                    fold(*block_first);
+                return acc;
+            },
+            [&fold_op](partial left, partial right)
+            {
+                if (!left)
+                    return right;
+                if (!right)
+                    return left;
+                return partial(fold_op(std::move(*left), std::move(*right)));
+            });
+        return result<R>(total);
+    }
+
+private:
+    // init (or R()) for an empty result, op(init, total) otherwise
+    template<typename R>
+    R result(const std::optional<R>& total) const
+    {
+        if constexpr (std::is_same_v<T, no_init>)
+            return total ? *total : R();
+        else
+            return total ? op(init, *total) : init;
+    }
+};
+
+// Writes the elements to d_first... like transform_parallel and returns the
+// end of the output. Pipelines with a filter have no fixed output position
+// per element and are rejected.
+template<typename OutputIt>
+struct to_stage
+{
+    static constexpr bool is_terminal = true;
+
+    OutputIt d_first;
+
+    template<typename Iterator, typename... Stages>
+    OutputIt operator()(const par_pipeline<Iterator, Stages...>& p) const
+    {
+        static_assert(!par_pipeline<Iterator, Stages...>::filters, "par::to cannot follow par::filter");
+
+        const std::size_t length = std::distance(p.first, p.last);
+        OutputIt d_last = d_first;
+        std::advance(d_last, length);
+        if (!length)
+            return d_last;
+
+        const OutputIt out_first = d_first;
+
+        split_for_tuned("par::to", p.first, length, [&p, out_first](Iterator block_first, Iterator block_last, std::size_t offset)
+        {
+            OutputIt out = out_first;
+            std::advance(out, offset);
+            auto store = p.make_sink([&out](const auto& value) { *out = value; ++out; });
+            for (; block_first != block_last; ++block_first)
+                store(*block_first);
+        });
+        return d_last;
+    }
+};
+
+template<typename T, typename Op>
+reduce_stage<T, std::decay_t<Op>> reduce(T init, Op&& op)
+{
+    return { std::move(init), std::forward<Op>(op) };
+}
+
+// Without init an empty result gives value_type()
+template<typename Op>
+reduce_stage<no_init, std::decay_t<Op>> reduce(Op&& op)
+{
+    return { no_init(), std::forward<Op>(op) };
+}
+
+template<typename T>
+reduce_stage<T, std::plus<>> sum(T init)
+{
+    return { std::move(init), std::plus<>() };
+}
+
+template<typename OutputIt>
+to_stage<OutputIt> to(OutputIt d_first)
+{
+    return { d_first };
+}
+
+
+/// === composition
+template<typename Stage, typename = void>
+struct is_stage : std::false_type
+{};
+
+template<typename Stage>
+struct is_stage<Stage, std::void_t<decltype(Stage::is_stage)>> : std::true_type
+{};
+
+template<typename Stage, typename = void>
+struct is_terminal : std::false_type
+{};
+
+template<typename Stage>
+struct is_terminal<Stage, std::void_t<decltype(Stage::is_terminal)>> : std::true_type
+{};
+
+} // namespace par
+
+
+template<typename Iterator, typename... Stages, typename Stage, std::enable_if_t<par::is_stage<Stage>::value, int> = 0>
+par_pipeline<Iterator, Stages..., Stage> operator|(const par_pipeline<Iterator, Stages...>& p, Stage stage)
+{
+    return p.then(std::move(stage));
+}
+
+template<typename Iterator, typename... Stages, typename Terminal, std::enable_if_t<par::is_terminal<Terminal>::value, int> = 0>
+auto operator|(const par_pipeline<Iterator, Stages...>& p, const Terminal& terminal)
+{
+    return terminal(p);
+}
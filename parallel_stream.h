@@ -0,0 +1,426 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#error "parallel_stream.h needs POSIX mmap"
+#endif
+
+#include "parallel_alghr.h"
+
+
+/// === out-of-core streaming
+// Runs the *_parallel algorithms over binary files of fixed-width records
+// (the raw bytes of a T, no header) that do not fit in memory. The file
+// goes through in chunks (64 MiB by default); every chunk is handed to the
+// pool as an ordinary range while the next one is being read, and is
+// dropped from the process once done, so resident memory stays at about
+// two chunks whatever the file size.
+//
+// stream_mode::mapped maps the whole file; before a chunk is processed the
+// next one gets MADV_WILLNEED (the kernel starts reading it ahead), and
+// after it MADV_DONTNEED. stream_mode::buffered reads with pread into two
+// buffers, the next chunk on a separate I/O thread, for file systems
+// where mmap is slow or unavailable.
+// Results are record indices; a miss is size().
+enum class stream_mode
+{
+    mapped,
+    buffered
+};
+
+std::size_t const stream_chunk_bytes = std::size_t(64) << 20;
+
+inline std::size_t stream_page_size()
+{
+    static const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return page;
+}
+
+[[noreturn]] inline void throw_errno(const std::string& what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+
+/// === file_descriptor
+class file_descriptor
+{
+private:
+    int fd;
+
+public:
+    explicit file_descriptor(int fd_ = -1) : fd(fd_)
+    {}
+
+    file_descriptor(file_descriptor&& other) noexcept : fd(std::exchange(other.fd, -1))
+    {}
+    file_descriptor& operator=(file_descriptor&& other) noexcept
+    {
+        std::swap(fd, other.fd);
+        return *this;
+    }
+    file_descriptor(const file_descriptor&) = delete;
+    file_descriptor& operator=(const file_descriptor&) = delete;
+
+    ~file_descriptor()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    int get() const
+    {
+        return fd;
+    }
+
+    std::size_t size() const
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+            throw_errno("fstat");
+        return static_cast<std::size_t>(st.st_size);
+    }
+};
+
+inline std::size_t record_count(std::size_t bytes, std::size_t record_size, const std::string& path)
+{
+    if (bytes % record_size)
+        throw std::runtime_error(path + ": size is not a whole number of records");
+    return bytes / record_size;
+}
+
+
+/// === mapped_records
+// A file of T records mapped as an array. mapped_records(path) maps an
+// existing file read-only; mapped_records(path, count) creates (or
+// truncates) the file with room for count records and maps it read-write,
+// as the output of transform_stream. will_need/release advise the kernel
+// about the records [first, first + n); release also starts the write-back
+// of a writable mapping, the data stays in the file.
+template<typename T>
+class mapped_records
+{
+    static_assert(std::is_trivially_copyable_v<T>, "records are read and written as raw bytes");
+
+private:
+    file_descriptor file;
+    T* base = nullptr;
+    std::size_t count = 0;
+    bool writable = false;
+
+    void map(const std::string& path)
+    {
+        if (!count)
+            return;
+        const int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+        void* p = mmap(nullptr, count * sizeof(T), prot, MAP_SHARED, file.get(), 0);
+        if (p == MAP_FAILED)
+            throw_errno("mmap " + path);
+        base = static_cast<T*>(p);
+        madvise(p, count * sizeof(T), MADV_SEQUENTIAL);
+    }
+
+    // page-aligned byte range of the records [first, first + n); inner
+    // drops the partial pages at both ends, which neighbours still use
+    std::pair<char*, std::size_t> pages(std::size_t first, std::size_t n, bool inner) const
+    {
+        const std::size_t page = stream_page_size();
+        std::size_t lo = first * sizeof(T);
+        std::size_t hi = std::min(first + n, count) * sizeof(T);
+        if (inner)
+        {
+            lo = (lo + page - 1) / page * page;
+            hi = (first + n >= count) ? hi : hi / page * page;
+        }
+        else
+        {
+            lo = lo / page * page;
+        }
+        return { reinterpret_cast<char*>(base) + lo, hi > lo ? hi - lo : 0 };
+    }
+
+public:
+    explicit mapped_records(const std::string& path) : file(::open(path.c_str(), O_RDONLY | O_CLOEXEC))
+    {
+        if (file.get() < 0)
+            throw_errno("open " + path);
+        count = record_count(file.size(), sizeof(T), path);
+        map(path);
+    }
+
+    mapped_records(const std::string& path, std::size_t count_)
+        : file(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)), count(count_), writable(true)
+    {
+        if (file.get() < 0)
+            throw_errno("open " + path);
+        if (ftruncate(file.get(), static_cast<off_t>(count * sizeof(T))) != 0)
+            throw_errno("ftruncate " + path);
+        map(path);
+    }
+
+    mapped_records(mapped_records&& other) noexcept
+        : file(std::move(other.file)), base(std::exchange(other.base, nullptr)),
+          count(std::exchange(other.count, 0)), writable(other.writable)
+    {}
+    mapped_records& operator=(mapped_records&&) = delete;
+    mapped_records(const mapped_records&) = delete;
+    mapped_records& operator=(const mapped_records&) = delete;
+
+    ~mapped_records()
+    {
+        if (base)
+            munmap(base, count * sizeof(T));
+    }
+
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    T* data()
+    {
+        return base;
+    }
+    const T* data() const
+    {
+        return base;
+    }
+
+    T* begin()
+    {
+        return base;
+    }
+    T* end()
+    {
+        return base + count;
+    }
+    const T* begin() const
+    {
+        return base;
+    }
+    const T* end() const
+    {
+        return base + count;
+    }
+
+    void will_need(std::size_t first, std::size_t n) const
+    {
+        const std::pair<char*, std::size_t> range = pages(first, n, false);
+        if (range.second)
+            madvise(range.first, range.second, MADV_WILLNEED);
+    }
+
+    void release(std::size_t first, std::size_t n) const
+    {
+        const std::pair<char*, std::size_t> range = pages(first, n, true);
+        if (!range.second)
+            return;
+        if (writable)
+            msync(range.first, range.second, MS_ASYNC);
+        madvise(range.first, range.second, MADV_DONTNEED);
+    }
+};
+
+
+/// === record_stream
+// Reads a file of T records chunk by chunk, see the top of the file.
+// for_each_chunk(f) calls f(const T* data, std::size_t n, std::size_t offset)
+// for consecutive chunks, from the calling thread, and stops early when f
+// returns false. Each pass reopens the file.
+template<typename T>
+class record_stream
+{
+    static_assert(std::is_trivially_copyable_v<T>, "records are read and written as raw bytes");
+
+private:
+    std::string path;
+    stream_mode mode;
+    std::size_t chunk;
+    std::size_t count;
+
+    file_descriptor open_file() const
+    {
+        file_descriptor file(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+        if (file.get() < 0)
+            throw_errno("open " + path);
+        return file;
+    }
+
+    static void read_records(int fd, T* dest, std::size_t offset, std::size_t n)
+    {
+        char* p = reinterpret_cast<char*>(dest);
+        std::size_t left = n * sizeof(T);
+        off_t pos = static_cast<off_t>(offset * sizeof(T));
+        while (left)
+        {
+            const ssize_t got = pread(fd, p, left, pos);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got < 0)
+                throw_errno("pread");
+            if (got == 0)
+                throw std::runtime_error("unexpected end of file");
+            p += got;
+            pos += got;
+            left -= static_cast<std::size_t>(got);
+        }
+    }
+
+    template<typename Func>
+    void mapped_pass(Func& f) const
+    {
+        const mapped_records<T> file(path);
+        // the file may have shrunk since count was taken; as in buffered_pass
+        if (file.size() < count)
+            throw std::runtime_error("unexpected end of file");
+        file.will_need(0, chunk);
+        for (std::size_t offset = 0; offset < count; offset += chunk)
+        {
+            const std::size_t n = std::min(chunk, count - offset);
+            file.will_need(offset + n, chunk);
+            const bool go = f(file.data() + offset, n, offset);
+            file.release(offset, n);
+            if (!go)
+                return;
+        }
+    }
+
+    template<typename Func>
+    void buffered_pass(Func& f) const
+    {
+        const file_descriptor file = open_file();
+        posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+        const int fd = file.get();
+        std::vector<T> buffers[2] = { std::vector<T>(std::min(chunk, count)), std::vector<T>(std::min(chunk, count)) };
+        std::future<void> pending = std::async(std::launch::async, read_records, fd, buffers[0].data(), 0, std::min(chunk, count));
+        for (std::size_t offset = 0, i = 0; offset < count; offset += chunk, i ^= 1)
+        {
+            const std::size_t n = std::min(chunk, count - offset);
+            pending.get();
+            if (offset + n < count)
+                pending = std::async(std::launch::async, read_records, fd, buffers[i ^ 1].data(), offset + n, std::min(chunk, count - offset - n));
+            bool go = false;
+            try
+            {
+                go = f(static_cast<const T*>(buffers[i].data()), n, offset);
+            }
+            catch (...)
+            {
+                if (pending.valid())
+                    pending.wait();
+                throw;
+            }
+            if (!go)
+            {
+                if (pending.valid())
+                    pending.wait();
+                return;
+            }
+        }
+    }
+
+public:
+    explicit record_stream(const std::string& path_, stream_mode mode_ = stream_mode::mapped, std::size_t chunk_bytes = stream_chunk_bytes)
+        : path(path_), mode(mode_), chunk(std::max<std::size_t>(chunk_bytes / sizeof(T), 1))
+    {
+        count = record_count(open_file().size(), sizeof(T), path);
+    }
+
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    std::size_t chunk_records() const
+    {
+        return chunk;
+    }
+
+    template<typename Func>
+    void for_each_chunk(Func f) const
+    {
+        if (!count)
+            return;
+        if (mode == stream_mode::mapped)
+            mapped_pass(f);
+        else
+            buffered_pass(f);
+    }
+};
+
+
+/// === accumulate_stream / find_stream / max_element_stream / transform_stream
+template<typename T, typename U>
+U accumulate_stream(const record_stream<T>& in, U init)
+{
+    in.for_each_chunk([&init](const T* data, std::size_t n, std::size_t)
+    {
+        init = accumulate_parallel(data, data + n, init);
+        return true;
+    });
+    return init;
+}
+
+template<typename T, typename Value>
+std::size_t find_stream(const record_stream<T>& in, Value val)
+{
+    std::size_t res = in.size();
+    in.for_each_chunk([&res, &val](const T* data, std::size_t n, std::size_t offset)
+    {
+        const T* found = find_parallel(data, data + n, val);
+        if (found == data + n)
+            return true;
+        res = offset + (found - data);
+        return false;
+    });
+    return res;
+}
+
+// first largest record, as std::max_element
+template<typename T>
+std::size_t max_element_stream(const record_stream<T>& in)
+{
+    std::size_t res = in.size();
+    T best{};
+    in.for_each_chunk([&res, &best, &in](const T* data, std::size_t n, std::size_t offset)
+    {
+        const T* found = max_element_parallel(data, data + n);
+        if (res == in.size() || best < *found)
+        {
+            best = *found;
+            res = offset + (found - data);
+        }
+        return true;
+    });
+    return res;
+}
+
+// out must hold in.size() records; every chunk of out is written back and
+// released as soon as it is filled
+template<typename T, typename U, typename UnaryOperation>
+void transform_stream(const record_stream<T>& in, mapped_records<U>& out, UnaryOperation op)
+{
+    if (out.size() != in.size())
+        throw std::invalid_argument("transform_stream: output size differs from input size");
+    in.for_each_chunk([&out, &op](const T* data, std::size_t n, std::size_t offset)
+    {
+        transform_parallel(data, data + n, out.data() + offset, op);
+        out.release(offset, n);
+        return true;
+    });
+}
@@ -0,0 +1,549 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+/// === parallel_trace
+// Opt-in instrumentation of the *_parallel calls, compiled in with
+// -DPARALLEL_TRACE=1. Without it the PAR_TRACE_* hooks expand to nothing
+// and the par_trace functions are empty stubs, so callers build both ways.
+//
+// Per call it records on each thread:
+//   call   the whole call on the thread that made it
+//   block  every leaf block (offset, length), with cycles and LLC misses
+//          when enable_counters(true) succeeded on that thread
+//   spawn  from submitting a task to a thread starting it
+//   join   the time a thread spends in pool.wait() for a forked half,
+//          minus the traced tasks it runs there meanwhile; those count
+//          as their own blocks and joins, so the join is the idle part
+// Blocks run by a worker are tied to the call that forked them. Events go
+// to per-thread buffers; read them with calls() or write_chrome_trace()
+// (chrome://tracing, Perfetto) while no traced call is running.
+
+namespace par_trace
+{
+
+struct call_stats
+{
+    std::uint64_t id = 0;
+    const char* name = "";
+    std::size_t length = 0;
+    double wall_us = 0;
+    std::size_t blocks = 0;
+    double block_min_us = 0, block_mean_us = 0, block_max_us = 0;
+    std::size_t threads = 0;            // threads that ran at least one block
+    double busy_max_us = 0, busy_mean_us = 0;
+    double imbalance = 0;               // busy_max / busy_mean, 1 is perfect
+    double spawn_delay_total_us = 0, spawn_delay_max_us = 0;
+    double join_wait_us = 0;            // summed over threads, see "join" above
+    bool counters = false;              // every block has counter values
+    std::uint64_t cycles = 0, llc_misses = 0;
+};
+
+} // namespace par_trace
+
+
+#if defined(PARALLEL_TRACE) && PARALLEL_TRACE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace par_trace
+{
+
+constexpr bool enabled = true;
+
+enum class kind : char { call, block, spawn, join };
+
+struct event
+{
+    kind what;
+    const char* name;
+    std::uint64_t call;
+    std::uint64_t begin_ns;
+    std::uint64_t end_ns;
+    std::size_t offset;
+    std::size_t length;
+    bool has_counters;
+    std::uint64_t cycles;
+    std::uint64_t llc_misses;
+};
+
+inline std::uint64_t now_ns()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+inline std::atomic<bool>& counters_wanted()
+{
+    static std::atomic<bool> flag{ false };
+    return flag;
+}
+
+/// === hardware counters
+// cycles and LLC misses of the calling thread as one perf_event group
+class thread_counters
+{
+private:
+    int leader = -1;
+    int misses = -1;
+
+#if defined(__linux__)
+    static int open_event(std::uint64_t config, int group)
+    {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+    }
+#endif
+
+public:
+    thread_counters() = default;
+    thread_counters(const thread_counters&) = delete;
+    thread_counters& operator=(const thread_counters&) = delete;
+
+    ~thread_counters()
+    {
+#if defined(__linux__)
+        if (misses >= 0)
+            close(misses);
+        if (leader >= 0)
+            close(leader);
+#endif
+    }
+
+    bool open()
+    {
+#if defined(__linux__)
+        if (leader < 0)
+        {
+            leader = open_event(PERF_COUNT_HW_CPU_CYCLES, -1);
+            if (leader >= 0)
+                misses = open_event(PERF_COUNT_HW_CACHE_MISSES, leader);
+            if (leader >= 0 && misses < 0)
+            {
+                close(leader);
+                leader = -1;
+            }
+        }
+        return leader >= 0;
+#else
+        return false;
+#endif
+    }
+
+    bool read(std::uint64_t& cycles, std::uint64_t& llc_misses) const
+    {
+#if defined(__linux__)
+        std::uint64_t values[3];    // nr, cycles, misses
+        if (leader < 0 || ::read(leader, values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)))
+            return false;
+        cycles = values[1];
+        llc_misses = values[2];
+        return true;
+#else
+        (void)cycles;
+        (void)llc_misses;
+        return false;
+#endif
+    }
+};
+
+
+/// === per-thread buffers
+struct thread_buffer
+{
+    unsigned tid;
+    std::mutex mut;     // only contended while someone reads the trace
+    std::vector<event> events;
+    thread_counters counters;
+    bool counters_tried = false;
+};
+
+class registry
+{
+private:
+    std::mutex mut;
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+    std::atomic<std::uint64_t> next_call{ 1 };
+
+public:
+    static registry& instance()
+    {
+        static registry r;
+        return r;
+    }
+
+    std::shared_ptr<thread_buffer> add()
+    {
+        auto buffer = std::make_shared<thread_buffer>();
+        std::lock_guard<std::mutex> lk(mut);
+        buffer->tid = static_cast<unsigned>(buffers.size());
+        buffers.push_back(buffer);
+        return buffer;
+    }
+
+    std::uint64_t new_call()
+    {
+        return next_call++;
+    }
+
+    std::vector<event> collect(std::vector<unsigned>& tids)
+    {
+        std::vector<event> all;
+        std::lock_guard<std::mutex> lk(mut);
+        for (const auto& buffer : buffers)
+        {
+            std::lock_guard<std::mutex> buffer_lk(buffer->mut);
+            all.insert(all.end(), buffer->events.begin(), buffer->events.end());
+            tids.insert(tids.end(), buffer->events.size(), buffer->tid);
+        }
+        return all;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lk(mut);
+        for (const auto& buffer : buffers)
+        {
+            std::lock_guard<std::mutex> buffer_lk(buffer->mut);
+            buffer->events.clear();
+        }
+    }
+};
+
+inline thread_buffer& local_buffer()
+{
+    // the registry keeps the buffer after the thread exits
+    thread_local std::shared_ptr<thread_buffer> buffer = registry::instance().add();
+    return *buffer;
+}
+
+inline std::uint64_t& current_call()
+{
+    thread_local std::uint64_t call = 0;
+    return call;
+}
+
+inline void record(const event& e)
+{
+    thread_buffer& buffer = local_buffer();
+    std::lock_guard<std::mutex> lk(buffer.mut);
+    buffer.events.push_back(e);
+}
+
+// Opens the counters of the calling thread; others open theirs at their
+// first block. Returns false where perf_event_open is not permitted.
+inline bool enable_counters(bool on)
+{
+    counters_wanted() = on;
+    return !on || local_buffer().counters.open();
+}
+
+inline void clear()
+{
+    registry::instance().clear();
+}
+
+
+/// === hooks
+class call_span
+{
+private:
+    const char* name;
+    std::size_t length;
+    std::uint64_t outer;
+    std::uint64_t begin;
+
+public:
+    call_span(const char* name_, std::size_t length_)
+        : name(name_), length(length_), outer(current_call()), begin(now_ns())
+    {
+        current_call() = registry::instance().new_call();
+    }
+
+    ~call_span()
+    {
+        record(event{ kind::call, name, current_call(), begin, now_ns(), 0, length, false, 0, 0 });
+        current_call() = outer;
+    }
+};
+
+class block_span
+{
+private:
+    std::size_t offset;
+    std::size_t length;
+    std::uint64_t begin;
+    bool has_counters = false;
+    std::uint64_t cycles = 0;
+    std::uint64_t llc_misses = 0;
+
+public:
+    block_span(std::size_t offset_, std::size_t length_) : offset(offset_), length(length_)
+    {
+        if (counters_wanted())
+        {
+            thread_buffer& buffer = local_buffer();
+            if (!buffer.counters_tried)
+            {
+                buffer.counters_tried = true;
+                buffer.counters.open();
+            }
+            has_counters = buffer.counters.read(cycles, llc_misses);
+        }
+        begin = now_ns();
+    }
+
+    ~block_span()
+    {
+        const std::uint64_t end = now_ns();
+        std::uint64_t cycles_end = 0;
+        std::uint64_t misses_end = 0;
+        const bool counted = has_counters && local_buffer().counters.read(cycles_end, misses_end);
+        record(event{ kind::block, "block", current_call(), begin, end, offset, length, counted,
+            counted ? cycles_end - cycles : 0, counted ? misses_end - llc_misses : 0 });
+    }
+};
+
+// Taken where a task is submitted, entered where it starts running
+struct fork_point
+{
+    std::uint64_t call = current_call();
+    std::uint64_t submitted = now_ns();
+};
+
+// A join is recorded in pieces: a task the waiting thread runs suspends
+// it, so the task's own time is not counted again as waiting
+class join_span
+{
+private:
+    std::uint64_t call = current_call();
+    std::uint64_t begin = now_ns();
+    join_span* outer;
+
+    void record_piece()
+    {
+        const std::uint64_t end = now_ns();
+        if (end > begin)
+            record(event{ kind::join, "join", call, begin, end, 0, 0, false, 0, 0 });
+    }
+
+public:
+    static join_span*& current()
+    {
+        thread_local join_span* join = nullptr;
+        return join;
+    }
+
+    join_span() : outer(current())
+    {
+        current() = this;
+    }
+
+    join_span(const join_span&) = delete;
+    join_span& operator=(const join_span&) = delete;
+
+    ~join_span()
+    {
+        record_piece();
+        current() = outer;
+    }
+
+    void suspend()
+    {
+        record_piece();
+    }
+
+    void resume()
+    {
+        begin = now_ns();
+    }
+};
+
+class task_scope
+{
+private:
+    std::uint64_t outer;
+    join_span* suspended;
+
+public:
+    explicit task_scope(const fork_point& fork) : outer(current_call()), suspended(join_span::current())
+    {
+        if (suspended)
+            suspended->suspend();
+        join_span::current() = nullptr;
+        current_call() = fork.call;
+        record(event{ kind::spawn, "spawn", fork.call, fork.submitted, now_ns(), 0, 0, false, 0, 0 });
+    }
+
+    task_scope(const task_scope&) = delete;
+    task_scope& operator=(const task_scope&) = delete;
+
+    ~task_scope()
+    {
+        current_call() = outer;
+        join_span::current() = suspended;
+        if (suspended)
+            suspended->resume();
+    }
+};
+
+
+/// === reports
+inline std::vector<call_stats> calls()
+{
+    std::vector<unsigned> tids;
+    const std::vector<event> events = registry::instance().collect(tids);
+
+    std::map<std::uint64_t, call_stats> by_call;
+    std::map<std::uint64_t, std::map<unsigned, double>> busy;
+    for (std::size_t i = 0; i < events.size(); ++i)
+    {
+        const event& e = events[i];
+        if (e.call == 0)
+            continue;
+        call_stats& s = by_call[e.call];
+        const double us = (e.end_ns - e.begin_ns) / 1e3;
+        switch (e.what)
+        {
+        case kind::call:
+            s.id = e.call;
+            s.name = e.name;
+            s.length = e.length;
+            s.wall_us = us;
+            break;
+        case kind::block:
+            s.block_min_us = s.blocks ? std::min(s.block_min_us, us) : us;
+            s.block_max_us = std::max(s.block_max_us, us);
+            s.block_mean_us += us;
+            s.counters = (s.blocks == 0 || s.counters) && e.has_counters;
+            s.cycles += e.cycles;
+            s.llc_misses += e.llc_misses;
+            ++s.blocks;
+            busy[e.call][tids[i]] += us;
+            break;
+        case kind::spawn:
+            s.spawn_delay_total_us += us;
+            s.spawn_delay_max_us = std::max(s.spawn_delay_max_us, us);
+            break;
+        case kind::join:
+            s.join_wait_us += us;
+            break;
+        }
+    }
+
+    std::vector<call_stats> res;
+    for (auto& [id, s] : by_call)
+    {
+        if (s.id == 0)
+            continue;       // still running, or cleared halfway
+        if (s.blocks)
+            s.block_mean_us /= s.blocks;
+        const std::map<unsigned, double>& per_thread = busy[id];
+        s.threads = per_thread.size();
+        double total = 0;
+        for (const auto& entry : per_thread)
+        {
+            total += entry.second;
+            s.busy_max_us = std::max(s.busy_max_us, entry.second);
+        }
+        s.busy_mean_us = s.threads ? total / s.threads : 0;
+        s.imbalance = s.busy_mean_us > 0 ? s.busy_max_us / s.busy_mean_us : 0;
+        if (!s.counters)
+        {
+            s.cycles = 0;
+            s.llc_misses = 0;
+        }
+        res.push_back(s);
+    }
+    return res;
+}
+
+// Chrome trace event format: one complete ("X") event per span
+inline void write_chrome_trace(std::ostream& out)
+{
+    std::vector<unsigned> tids;
+    const std::vector<event> events = registry::instance().collect(tids);
+    out << "{\"traceEvents\": [\n";
+    for (std::size_t i = 0; i < events.size(); ++i)
+    {
+        const event& e = events[i];
+        static const char* const categories[] = { "call", "block", "spawn", "join" };
+        out << "  {\"name\": \"" << e.name << "\", \"cat\": \"" << categories[static_cast<int>(e.what)]
+            << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tids[i]
+            << ", \"ts\": " << e.begin_ns / 1e3 << ", \"dur\": " << (e.end_ns - e.begin_ns) / 1e3
+            << ", \"args\": {\"call\": " << e.call;
+        if (e.what == kind::call || e.what == kind::block)
+            out << ", \"offset\": " << e.offset << ", \"length\": " << e.length;
+        if (e.has_counters)
+            out << ", \"cycles\": " << e.cycles << ", \"llc_misses\": " << e.llc_misses;
+        out << "}}" << (i + 1 < events.size() ? "," : "") << '\n';
+    }
+    out << "], \"displayTimeUnit\": \"ns\"}\n";
+}
+
+} // namespace par_trace
+
+#define PAR_TRACE_CONCAT_(a, b) a##b
+#define PAR_TRACE_CONCAT(a, b) PAR_TRACE_CONCAT_(a, b)
+#define PAR_TRACE_CALL(name, length) const par_trace::call_span PAR_TRACE_CONCAT(par_trace_call_, __LINE__)(name, length)
+#define PAR_TRACE_BLOCK(offset, length) const par_trace::block_span PAR_TRACE_CONCAT(par_trace_block_, __LINE__)(offset, length)
+#define PAR_TRACE_FORK(fork) const par_trace::fork_point fork
+#define PAR_TRACE_TASK(fork) const par_trace::task_scope PAR_TRACE_CONCAT(par_trace_task_, __LINE__)(fork)
+#define PAR_TRACE_JOIN() const par_trace::join_span PAR_TRACE_CONCAT(par_trace_join_, __LINE__)
+
+#else
+
+namespace par_trace
+{
+
+constexpr bool enabled = false;
+
+inline bool enable_counters(bool)
+{
+    return false;
+}
+
+inline void clear()
+{}
+
+inline std::vector<call_stats> calls()
+{
+    return {};
+}
+
+inline void write_chrome_trace(std::ostream& out)
+{
+    out << "{\"traceEvents\": []}\n";
+}
+
+} // namespace par_trace
+
+#define PAR_TRACE_CALL(name, length) ((void)0)
+#define PAR_TRACE_BLOCK(offset, length) ((void)0)
+#define PAR_TRACE_FORK(fork) ((void)0)
+#define PAR_TRACE_TASK(fork) ((void)0)
+#define PAR_TRACE_JOIN() ((void)0)
+
+#endif
@@ -0,0 +1,123 @@
+// queue_batch_bench.cpp : items/s through threadsafe_queue at batch sizes
+// 1 (push / wait_and_pop), 16 and 256 (push_bulk / wait_and_pop_bulk),
+// unbounded and with a capacity of 1024. Half the threads produce, half
+// consume (at least one of each). Arguments: threads (default 4), then
+// millions of items (default 4).
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <iterator>
+
+#include "Tvector.h"
+
+
+/// === helpers
+struct batch_result
+{
+    double items_per_sec;
+    bool ok;
+};
+
+// Consumers stop at a negative item: one per consumer is pushed after the
+// producers are done, and a consumer that gets more than one passes the
+// rest back
+batch_result run_batches(unsigned threads, std::size_t items, std::size_t batch, std::size_t capacity)
+{
+    const unsigned producers = std::max(1u, threads / 2);
+    const unsigned consumers = std::max(1u, threads - producers);
+    const std::size_t per_producer = items / producers;
+    threadsafe_queue<int> queue(capacity);
+    std::atomic<std::int64_t> sum(0);
+
+    std::vector<std::thread> workers;
+    const auto t1 = std::chrono::steady_clock::now();
+    for (unsigned p = 0; p < producers; ++p)
+    {
+        workers.emplace_back([&] {
+            std::vector<int> buffer;
+            buffer.reserve(batch);
+            for (std::size_t i = 0; i < per_producer; ++i)
+            {
+                if (batch == 1)
+                {
+                    queue.push(static_cast<int>(i));
+                    continue;
+                }
+                buffer.push_back(static_cast<int>(i));
+                if (buffer.size() == batch)
+                {
+                    queue.push_bulk(buffer);
+                    buffer.clear();
+                }
+            }
+            queue.push_bulk(buffer);
+        });
+    }
+    for (unsigned c = 0; c < consumers; ++c)
+    {
+        workers.emplace_back([&] {
+            std::vector<int> buffer;
+            buffer.reserve(batch);
+            std::int64_t local = 0;
+            int stops = 0;
+            while (!stops)
+            {
+                buffer.clear();
+                if (batch == 1)
+                    buffer.push_back(queue.wait_and_pop_value());
+                else
+                    queue.wait_and_pop_bulk(std::back_inserter(buffer), batch);
+                for (int x : buffer)
+                {
+                    if (x < 0)
+                        ++stops;
+                    else
+                        local += x;
+                }
+            }
+            for (int k = 1; k < stops; ++k)
+                queue.push(-1);
+            sum += local;
+        });
+    }
+    for (unsigned p = 0; p < producers; ++p)
+        workers[p].join();
+    for (unsigned c = 0; c < consumers; ++c)
+        queue.push(-1);
+    for (unsigned c = 0; c < consumers; ++c)
+        workers[producers + c].join();
+    const auto t2 = std::chrono::steady_clock::now();
+
+    const std::chrono::duration<double> sec = t2 - t1;
+    const std::int64_t expected = static_cast<std::int64_t>(producers) * static_cast<std::int64_t>(per_producer)
+        * static_cast<std::int64_t>(per_producer - 1) / 2;
+    return { per_producer * producers / sec.count(), sum.load() == expected };
+}
+
+
+int main(int argc, char* argv[])
+{
+    const unsigned threads = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 4;
+    const std::size_t items = (argc > 2 ? std::stoul(argv[2]) : 4) * 1'000'000;
+    std::cout << "threads: " << threads << ", items: " << items << "\n\n";
+
+    std::cout << std::setw(12) << std::left << "batch" << std::setw(14) << "capacity" << "Mitems/s\n";
+    for (std::size_t capacity : { std::size_t(0), std::size_t(1024) })
+    {
+        for (std::size_t batch : { 1, 16, 256 })
+        {
+            const batch_result r = run_batches(threads, items, batch, capacity);
+            std::cout << std::setw(12) << batch << std::setw(14) << (capacity ? std::to_string(capacity) : "unbounded")
+                      << std::fixed << std::setprecision(2) << r.items_per_sec / 1e6 << std::defaultfloat
+                      << (r.ok ? "" : "  (lost items)") << '\n';
+        }
+    }
+
+    return 0;
+}
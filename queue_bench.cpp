@@ -0,0 +1,87 @@
+// queue_bench.cpp : producer/consumer throughput of mpmc_queue against the
+// mutex-based threadsafe_queue, 1 to 64 threads (half producers, half consumers;
+// the 1-thread row still runs one producer and one consumer).
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "Tvector.h"
+#include "mpmc_queue.h"
+
+
+/// === helpers
+// Millions of items per second through the queue
+template<typename Queue>
+double throughput(Queue& queue, unsigned threads, std::size_t items)
+{
+    const unsigned producers = (threads + 1) / 2;
+    const unsigned consumers = (threads > 1) ? threads / 2 : 1;
+    const std::size_t per_producer = items / producers;
+    const std::size_t total = per_producer * producers;
+
+    std::atomic<bool> go(false);
+    std::atomic<std::size_t> consumed(0);
+    std::vector<std::thread> workers;
+    workers.reserve(producers + consumers);
+
+    for (unsigned p = 0; p < producers; ++p)
+    {
+        workers.emplace_back([&] {
+            while (!go.load())
+                std::this_thread::yield();
+            for (std::size_t i = 0; i < per_producer; ++i)
+                queue.push(static_cast<int>(i));
+        });
+    }
+    for (unsigned c = 0; c < consumers; ++c)
+    {
+        workers.emplace_back([&] {
+            while (!go.load())
+                std::this_thread::yield();
+            int value;
+            while (consumed.load(std::memory_order_relaxed) < total)
+            {
+                if (queue.try_pop(value))
+                    consumed.fetch_add(1, std::memory_order_relaxed);
+                else
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    const auto t1 = std::chrono::steady_clock::now();
+    go.store(true);
+    for (std::thread& th : workers)
+        th.join();
+    const auto t2 = std::chrono::steady_clock::now();
+    return total / std::chrono::duration<double, std::micro>(t2 - t1).count();
+}
+
+
+int main()
+{
+    const std::size_t items = 2'000'000u;
+    const std::size_t capacity = 1u << 16;
+    const unsigned thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(10) << std::left << "threads" << std::setw(22) << "threadsafe_queue Mops"
+              << std::setw(18) << "mpmc_queue Mops" << "speedup\n";
+
+    for (unsigned threads : thread_counts)
+    {
+        threadsafe_queue<int> locked;
+        mpmc_queue<int> lockfree(capacity);
+        const double old_rate = throughput(locked, threads, items);
+        const double new_rate = throughput(lockfree, threads, items);
+        std::cout << std::setw(10) << threads << std::setw(22) << old_rate
+                  << std::setw(18) << new_rate << new_rate / old_rate << "x\n";
+    }
+
+    return 0;
+}
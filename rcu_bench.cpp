@@ -0,0 +1,87 @@
+// rcu_bench.cpp : reader scaling of rcu_vector against the mutex-based
+// Tvector under a ~99% read / ~1% write mix.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <random>
+
+#include "Tvector.h"
+#include "rcu_vector.h"
+
+
+/// === helpers
+// millions of operations per second; every 100th operation is a write
+// (push_back followed by erase(0), so the size stays around its start value)
+template<typename Vector>
+double throughput(Vector& vec, unsigned threads, std::size_t ops_per_thread, std::size_t max_index)
+{
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            std::minstd_rand eng(t + 1);
+            std::uniform_int_distribution<std::size_t> index(0, max_index);
+            long long sum = 0;
+            while (!go.load())
+                std::this_thread::yield();
+            for (std::size_t i = 0; i < ops_per_thread; ++i)
+            {
+                if (i % 100 == 99)
+                {
+                    vec.push_back(static_cast<int>(i));
+                    vec.erase(0);
+                }
+                else
+                    sum += vec[index(eng)];
+            }
+            volatile long long sink = sum;
+            (void)sink;
+        });
+    }
+
+    const auto t1 = std::chrono::steady_clock::now();
+    go.store(true);
+    for (std::thread& th : workers)
+        th.join();
+    const auto t2 = std::chrono::steady_clock::now();
+    return threads * ops_per_thread / std::chrono::duration<double, std::micro>(t2 - t1).count();
+}
+
+
+int main()
+{
+    const std::size_t size = 1024u;
+    const std::size_t ops = 500'000u;
+    const unsigned thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(10) << std::left << "readers" << std::setw(16) << "Tvector Mops"
+              << std::setw(18) << "rcu_vector Mops" << "speedup\n";
+
+    for (unsigned threads : thread_counts)
+    {
+        Tvector<int> locked;
+        rcu_vector<int> rcu;
+        for (std::size_t i = 0; i < size; ++i)
+            locked.push_back(static_cast<int>(i));
+        rcu.update([size](std::vector<int>& v) {
+            for (std::size_t i = 0; i < size; ++i)
+                v.push_back(static_cast<int>(i));
+        });
+        // every thread is at most one element behind, so this index stays valid
+        const std::size_t max_index = size - threads - 1;
+        const double old_rate = throughput(locked, threads, ops, max_index);
+        const double new_rate = throughput(rcu, threads, ops, max_index);
+        std::cout << std::setw(10) << threads << std::setw(16) << old_rate
+                  << std::setw(18) << new_rate << new_rate / old_rate << "x\n";
+    }
+
+    return 0;
+}
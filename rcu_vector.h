@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if !defined(__cpp_lib_span)
+#error "rcu_vector.h needs C++20 std::span"
+#endif
+
+
+/// === epoch-based read side
+// A reader stores the global epoch it saw in its slot before it loads the
+// current version, and clears the slot when it is done. A version replaced
+// during epoch E is freed once every active slot holds an epoch above E.
+// Entering and leaving is a fixed number of atomic stores, so readers are
+// wait-free; a thread that nests snapshots keeps its outermost epoch.
+unsigned const max_rcu_readers = 128;
+
+struct rcu_reader_slot
+{
+    std::atomic<std::thread::id> id;
+    std::atomic<std::uint64_t> epoch;
+};
+
+inline rcu_reader_slot rcu_reader_slots[max_rcu_readers];
+inline std::atomic<std::uint64_t> rcu_global_epoch{ 1 };
+
+class rcu_reader
+{
+private:
+    rcu_reader_slot* slot;
+    unsigned nesting;
+
+public:
+    rcu_reader() : slot(nullptr), nesting(0)
+    {
+        for (unsigned i = 0; i < max_rcu_readers; ++i)
+        {
+            std::thread::id old_id;
+            if (rcu_reader_slots[i].id.compare_exchange_strong(old_id, std::this_thread::get_id()))
+            {
+                slot = &rcu_reader_slots[i];
+                break;
+            }
+        }
+        if (!slot)
+            throw std::runtime_error("No rcu reader slots available");
+    }
+
+    rcu_reader(const rcu_reader&) = delete;
+    rcu_reader& operator=(const rcu_reader&) = delete;
+
+    ~rcu_reader()
+    {
+        slot->epoch.store(0);
+        slot->id.store(std::thread::id());
+    }
+
+    void enter()
+    {
+        if (nesting++ == 0)
+            slot->epoch.store(rcu_global_epoch.load());
+    }
+
+    void leave()
+    {
+        if (--nesting == 0)
+            slot->epoch.store(0, std::memory_order_release);
+    }
+
+    static rcu_reader& for_current_thread()
+    {
+        thread_local static rcu_reader reader;
+        return reader;
+    }
+};
+
+// Smallest epoch any reader is still in, or UINT64_MAX without readers
+inline std::uint64_t rcu_oldest_reader_epoch()
+{
+    std::uint64_t oldest = UINT64_MAX;
+    for (unsigned i = 0; i < max_rcu_readers; ++i)
+    {
+        const std::uint64_t e = rcu_reader_slots[i].epoch.load();
+        if (e != 0 && e < oldest)
+            oldest = e;
+    }
+    return oldest;
+}
+
+
+/// === rcu_vector
+// Read-mostly alternative to Tvector: readers never lock, writers copy the
+// current version, change the copy and publish it. Every write is O(size),
+// so batch several changes with update(). Snapshots must not outlive the
+// rcu_vector they were taken from.
+template<typename T = int>
+class rcu_vector
+{
+private:
+    using version = std::vector<T>;
+
+    struct retired_version
+    {
+        std::uint64_t epoch;
+        std::unique_ptr<const version> data;
+    };
+
+    std::atomic<const version*> current;
+    std::mutex write_mute;
+    std::vector<retired_version> retired;
+
+    // write_mute must be held
+    void publish(std::unique_ptr<version> next)
+    {
+        const version* old = current.exchange(next.release());
+        const std::uint64_t epoch = rcu_global_epoch.fetch_add(1);
+        retired.push_back(retired_version{ epoch, std::unique_ptr<const version>(old) });
+
+        const std::uint64_t oldest = rcu_oldest_reader_epoch();
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+            [oldest](const retired_version& r) { return r.epoch < oldest; }), retired.end());
+    }
+
+public:
+    // Immutable view of one version; keeps it alive until destroyed
+    class snapshot_type
+    {
+    private:
+        const version* data;
+
+    public:
+        snapshot_type(const version* data_) : data(data_)
+        {}
+
+        snapshot_type(snapshot_type&& other) noexcept : data(std::exchange(other.data, nullptr))
+        {}
+        snapshot_type(const snapshot_type&) = delete;
+        snapshot_type& operator=(const snapshot_type&) = delete;
+        snapshot_type& operator=(snapshot_type&&) = delete;
+
+        ~snapshot_type()
+        {
+            if (data)
+                rcu_reader::for_current_thread().leave();
+        }
+
+        std::span<const T> span() const
+        {
+            return std::span<const T>(data->data(), data->size());
+        }
+        const T& operator[](std::size_t index) const
+        {
+            return (*data)[index];
+        }
+        std::size_t size() const
+        {
+            return data->size();
+        }
+        auto begin() const
+        {
+            return data->cbegin();
+        }
+        auto end() const
+        {
+            return data->cend();
+        }
+    };
+
+    rcu_vector() : current(new version())
+    {}
+
+    rcu_vector(std::initializer_list<T> l) : current(new version(l))
+    {}
+
+    rcu_vector(const rcu_vector&) = delete;
+    rcu_vector& operator=(const rcu_vector&) = delete;
+
+    ~rcu_vector()
+    {
+        delete current.load();
+    }
+
+    // Wait-free; the snapshot must be released on the thread that took it
+    snapshot_type snapshot() const
+    {
+        rcu_reader::for_current_thread().enter();
+        return snapshot_type(current.load());
+    }
+
+    T operator[](std::size_t index) const
+    {
+        return snapshot()[index];
+    }
+    std::size_t size() const
+    {
+        return snapshot().size();
+    }
+    T get_max() const
+    {
+        const snapshot_type s = snapshot();
+        return *std::max_element(s.begin(), s.end());
+    }
+    T get_min() const
+    {
+        const snapshot_type s = snapshot();
+        return *std::min_element(s.begin(), s.end());
+    }
+
+    // Applies fn(std::vector<T>&) to a private copy and publishes the result
+    template<typename Func>
+    void update(Func fn)
+    {
+        std::lock_guard<std::mutex> lock_push(write_mute);
+        std::unique_ptr<version> next(new version(*current.load()));
+        fn(*next);
+        publish(std::move(next));
+    }
+
+    void push_back(const T& value)
+    {
+        update([&value](version& v) { v.push_back(value); });
+    }
+    void resize(std::size_t newsize)
+    {
+        update([newsize](version& v) { v.resize(newsize); });
+    }
+    void erase(const std::size_t index)
+    {
+        update([index](version& v) { v.erase(v.begin() + index); });
+    }
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock_push(write_mute);
+        publish(std::unique_ptr<version>(new version()));
+    }
+};
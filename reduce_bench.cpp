@@ -0,0 +1,92 @@
+// reduce_bench.cpp : accuracy and speed of accumulate_parallel_reproducible
+// against std::reduce(par), std::accumulate and accumulate_parallel.
+// Run it with different pool sizes (first argument) to check that the
+// reproducible result does not change with the thread count.
+//
+
+#include <execution>
+#define SEQ std::execution::seq
+#define PAR std::execution::par
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <numeric>
+#include <random>
+#include <cmath>
+#include <string>
+
+#include "parallel_alghr.h"
+
+
+/// === helpers
+// reference value: compensated sum in long double
+template<typename T>
+long double reference_sum(const std::vector<T>& v)
+{
+    compensated_sum<long double> acc{ 0.0L, 0.0L };
+    for (const T& x : v)
+        neumaier_add(acc, static_cast<long double>(x));
+    return acc.value();
+}
+
+template<typename T, typename Func>
+void eval(const std::string& name, const std::vector<T>& v, long double reference, Func fun)
+{
+    fun(); // warmup
+    const auto t1 = std::chrono::steady_clock::now();
+    const T result = fun();
+    const auto t2 = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> sec = t2 - t1;
+    std::cout << std::setw(36) << std::left << name
+              << std::setprecision(17) << std::setw(26) << result
+              << std::setprecision(3) << std::setw(14) << std::fabs(static_cast<long double>(result) - reference)
+              << std::fixed << std::setw(12) << sec.count() * 1000
+              << std::setw(10) << v.size() * sizeof(T) / sec.count() / 1e9 << '\n' << std::defaultfloat;
+}
+
+template<typename T>
+void run(const std::string& title, const std::vector<T>& v)
+{
+    const long double reference = reference_sum(v);
+    std::cout << "=== " << title << "  (reference " << std::setprecision(20) << reference << ")\n";
+    std::cout << std::setw(36) << std::left << "algorithm" << std::setw(26) << "result"
+              << std::setw(14) << "abs error" << std::setw(12) << "ms" << "GB/s\n";
+
+    eval("std::accumulate", v, reference, [&v] { return std::accumulate(v.cbegin(), v.cend(), T()); });
+    eval("std::reduce (par)", v, reference, [&v] { return std::reduce(PAR, v.cbegin(), v.cend(), T()); });
+    eval("accumulate_parallel", v, reference, [&v] { return accumulate_parallel(v.cbegin(), v.cend(), T()); });
+    eval("accumulate_parallel_reproducible", v, reference, [&v] { return accumulate_parallel_reproducible(v.cbegin(), v.cend(), T()); });
+    std::cout << '\n';
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        thread_pool::set_size(static_cast<unsigned>(std::stoul(argv[1])));
+    std::cout << "pool workers: " << thread_pool::instance().size() << " (+ calling thread)\n\n";
+
+    const size_t data_size = 150'000'007u;
+    {
+        const std::vector<double> v(data_size, 0.1);
+        run("150M x 0.1 (double)", v);
+    }
+    {
+        // mixed signs and magnitudes, where summation order matters most
+        std::vector<double> v(data_size);
+        std::mt19937_64 eng(42);
+        std::uniform_real_distribution<double> mantissa(-1.0, 1.0);
+        std::uniform_int_distribution<int> exponent(-8, 8);
+        for (double& x : v)
+            x = std::ldexp(mantissa(eng), exponent(eng) * 4);
+        run("150M mixed magnitude (double)", v);
+    }
+    {
+        const std::vector<float> v(data_size / 4, 0.1f);
+        run("37.5M x 0.1 (float)", v);
+    }
+
+    return 0;
+}
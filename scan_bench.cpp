@@ -0,0 +1,96 @@
+// scan_bench.cpp : bandwidth of inclusive/exclusive_scan_parallel against
+// std::inclusive_scan on the 150M elements of parallel_alghorithms.cpp.
+// Every parallel result is checked against the serial std:: scan first.
+// GB/s counts one read and one write per element.
+//
+
+#include <execution>
+#define SEQ std::execution::seq
+#define PAR std::execution::par
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <numeric>
+#include <cmath>
+#include <string>
+
+#include "parallel_alghr.h"
+
+
+/// === helpers
+template<typename T>
+bool same(const std::vector<T>& result, const std::vector<T>& expected)
+{
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        // the grouping differs from the serial scan
+        for (std::size_t i = 0; i < result.size(); ++i)
+            if (std::fabs(result[i] - expected[i]) > 1e-9 * std::fabs(expected[i]) + 1e-9)
+                return false;
+        return true;
+    }
+    else
+        return result == expected;
+}
+
+template<typename T, typename Func>
+void eval(const std::string& name, const std::vector<T>& expected, std::vector<T>& out, Func fun)
+{
+    fun(); // warmup, also the result that is checked
+    const bool ok = same(out, expected);
+    const auto t1 = std::chrono::steady_clock::now();
+    fun();
+    const auto t2 = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> sec = t2 - t1;
+    std::cout << std::setw(40) << std::left << name
+              << std::fixed << std::setprecision(1) << std::setw(12) << sec.count() * 1000
+              << std::setw(10) << 2 * out.size() * sizeof(T) / sec.count() / 1e9
+              << (ok ? "ok" : "MISMATCH") << '\n' << std::defaultfloat;
+}
+
+template<typename T>
+void run(const std::string& title, const std::vector<T>& v)
+{
+    std::cout << "=== " << title << '\n';
+    std::cout << std::setw(40) << std::left << "algorithm" << std::setw(12) << "ms" << std::setw(10) << "GB/s" << "check\n";
+
+    // one expected result at a time, 150M doubles are 1.2 GB each
+    std::vector<T> out(v.size());
+    std::vector<T> expected(v.size());
+    std::inclusive_scan(v.cbegin(), v.cend(), expected.begin());
+    eval("std::inclusive_scan", expected, out, [&] { std::inclusive_scan(v.cbegin(), v.cend(), out.begin()); });
+    eval("std::inclusive_scan (par)", expected, out, [&] { std::inclusive_scan(PAR, v.cbegin(), v.cend(), out.begin()); });
+    eval("inclusive_scan_parallel", expected, out, [&] { inclusive_scan_parallel(v.cbegin(), v.cend(), out.begin()); });
+
+    std::exclusive_scan(v.cbegin(), v.cend(), expected.begin(), T(1));
+    eval("exclusive_scan_parallel", expected, out, [&] { exclusive_scan_parallel(v.cbegin(), v.cend(), out.begin(), T(1)); });
+
+    auto twice = [](T x) { return x + x; };
+    std::transform_inclusive_scan(v.cbegin(), v.cend(), expected.begin(), std::plus<>(), twice);
+    eval("transform_inclusive_scan_parallel", expected, out, [&] { transform_inclusive_scan_parallel(v.cbegin(), v.cend(), out.begin(), std::plus<>(), twice); });
+    std::cout << '\n';
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        thread_pool::set_size(static_cast<unsigned>(std::stoul(argv[1])));
+    std::cout << "pool workers: " << thread_pool::instance().size() << " (+ calling thread)\n\n";
+
+    const size_t data_size = 150'000'007u;
+    {
+        std::vector<long> v(data_size);
+        generate_random_parallel(v.begin(), v.end(), -1000L, 1000L);
+        run("150M long", v);
+    }
+    {
+        std::vector<double> v(data_size);
+        generate_random_parallel(v.begin(), v.end(), 0.0, 1.0);
+        run("150M double", v);
+    }
+
+    return 0;
+}
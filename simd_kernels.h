@@ -0,0 +1,825 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <array>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_KERNELS_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_KERNELS_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__clang__)
+#define SIMD_KERNELS_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define SIMD_KERNELS_UNROLL _Pragma("GCC unroll 16")
+#else
+#define SIMD_KERNELS_UNROLL
+#endif
+
+
+/// === helpers
+inline unsigned lowest_set_bit(unsigned mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Element types the vector kernels handle: plain integers and float/double
+template<typename T>
+constexpr bool simd_arithmetic_v = std::is_arithmetic_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, long double>
+    && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+
+// Element types of the ordered (min/max) kernels
+template<typename T>
+constexpr bool simd_ordered_v = std::is_same_v<T, std::int32_t> || std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+
+/// === register abstraction
+// Everything is kept in integer registers; float/double compares go through
+// casts so one movemask_epi8 serves all element types (sizeof(T) bits each)
+#if defined(SIMD_KERNELS_AVX2)
+struct simd_isa
+{
+    using reg = __m256i;
+    static constexpr std::size_t width = 32;
+
+    static reg load(const void* p)
+    {
+        return _mm256_loadu_si256(static_cast<const __m256i*>(p));
+    }
+    static reg bit_or(reg a, reg b)
+    {
+        return _mm256_or_si256(a, b);
+    }
+    static unsigned movemask(reg a)
+    {
+        return static_cast<unsigned>(_mm256_movemask_epi8(a));
+    }
+
+    template<typename T>
+    static reg broadcast(T v)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm256_castps_si256(_mm256_set1_ps(v));
+        else if constexpr (std::is_same_v<T, double>)
+            return _mm256_castpd_si256(_mm256_set1_pd(v));
+        else if constexpr (sizeof(T) == 1)
+            return _mm256_set1_epi8(static_cast<char>(v));
+        else if constexpr (sizeof(T) == 2)
+            return _mm256_set1_epi16(static_cast<short>(v));
+        else if constexpr (sizeof(T) == 4)
+            return _mm256_set1_epi32(static_cast<int>(v));
+        else
+            return _mm256_set1_epi64x(static_cast<long long>(v));
+    }
+
+    template<typename T>
+    static reg cmpeq(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_EQ_OQ));
+        else if constexpr (std::is_same_v<T, double>)
+            return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_EQ_OQ));
+        else if constexpr (sizeof(T) == 1)
+            return _mm256_cmpeq_epi8(a, b);
+        else if constexpr (sizeof(T) == 2)
+            return _mm256_cmpeq_epi16(a, b);
+        else if constexpr (sizeof(T) == 4)
+            return _mm256_cmpeq_epi32(a, b);
+        else
+            return _mm256_cmpeq_epi64(a, b);
+    }
+
+    static void store(void* p, reg a)
+    {
+        _mm256_storeu_si256(static_cast<__m256i*>(p), a);
+    }
+    // lanes of mask set pick b, clear pick a
+    static reg blend(reg a, reg b, reg mask)
+    {
+        return _mm256_blendv_epi8(a, b, mask);
+    }
+
+    // lane indices 0, 1, ... in lanes of sizeof(T) bytes
+    template<typename T>
+    static reg index_init()
+    {
+        if constexpr (sizeof(T) == 4)
+            return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        else
+            return _mm256_setr_epi64x(0, 1, 2, 3);
+    }
+    template<typename T>
+    static reg index_add(reg a, reg b)
+    {
+        if constexpr (sizeof(T) == 4)
+            return _mm256_add_epi32(a, b);
+        else
+            return _mm256_add_epi64(a, b);
+    }
+    template<typename T>
+    static reg index_broadcast(std::size_t v)
+    {
+        if constexpr (sizeof(T) == 4)
+            return _mm256_set1_epi32(static_cast<int>(v));
+        else
+            return _mm256_set1_epi64x(static_cast<long long>(v));
+    }
+
+    // a < b for int32_t, float and double
+    template<typename T>
+    static reg cmplt(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_LT_OQ));
+        else if constexpr (std::is_same_v<T, double>)
+            return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_LT_OQ));
+        else
+            return _mm256_cmpgt_epi32(b, a);
+    }
+
+    static reg zero()
+    {
+        return _mm256_setzero_si256();
+    }
+    template<typename T>
+    static reg fadd(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm256_castps_si256(_mm256_add_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b)));
+        else
+            return _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b)));
+    }
+    template<typename T>
+    static reg fsub(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm256_castps_si256(_mm256_sub_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b)));
+        else
+            return _mm256_castpd_si256(_mm256_sub_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b)));
+    }
+    // clears the sign bits
+    template<typename T>
+    static reg fabs(reg a)
+    {
+        return _mm256_andnot_si256(broadcast<T>(T(-0.0)), a);
+    }
+    template<typename T>
+    static reg cmpge(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm256_castps_si256(_mm256_cmp_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b), _CMP_GE_OQ));
+        else
+            return _mm256_castpd_si256(_mm256_cmp_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b), _CMP_GE_OQ));
+    }
+    template<typename T>
+    static reg fmul(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm256_castps_si256(_mm256_mul_ps(_mm256_castsi256_ps(a), _mm256_castsi256_ps(b)));
+        else
+            return _mm256_castpd_si256(_mm256_mul_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b)));
+    }
+
+    static reg bit_xor(reg a, reg b)
+    {
+        return _mm256_xor_si256(a, b);
+    }
+    static reg add_u32(reg a, reg b)
+    {
+        return _mm256_add_epi32(a, b);
+    }
+    static reg add_u64(reg a, reg b)
+    {
+        return _mm256_add_epi64(a, b);
+    }
+    static reg srl_u32(reg a, int count)
+    {
+        return _mm256_srli_epi32(a, count);
+    }
+    static reg srl_u64(reg a, int count)
+    {
+        return _mm256_srli_epi64(a, count);
+    }
+    // 64-bit products of the low 32 bits of every 64-bit lane
+    static reg mul_u32_wide(reg a, reg b)
+    {
+        return _mm256_mul_epu32(a, b);
+    }
+    // high and low halves of the 32x32 bit products of every 32-bit lane; b
+    // must hold the same value in both halves of each 64-bit lane
+    static void mul_hilo_u32(reg a, reg b, reg& hi, reg& lo)
+    {
+        const reg even = _mm256_mul_epu32(a, b);
+        const reg odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b);
+        lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    }
+};
+#elif defined(SIMD_KERNELS_SSE2)
+struct simd_isa
+{
+    using reg = __m128i;
+    static constexpr std::size_t width = 16;
+
+    static reg load(const void* p)
+    {
+        return _mm_loadu_si128(static_cast<const __m128i*>(p));
+    }
+    static reg bit_or(reg a, reg b)
+    {
+        return _mm_or_si128(a, b);
+    }
+    static unsigned movemask(reg a)
+    {
+        return static_cast<unsigned>(_mm_movemask_epi8(a));
+    }
+
+    template<typename T>
+    static reg broadcast(T v)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm_castps_si128(_mm_set1_ps(v));
+        else if constexpr (std::is_same_v<T, double>)
+            return _mm_castpd_si128(_mm_set1_pd(v));
+        else if constexpr (sizeof(T) == 1)
+            return _mm_set1_epi8(static_cast<char>(v));
+        else if constexpr (sizeof(T) == 2)
+            return _mm_set1_epi16(static_cast<short>(v));
+        else if constexpr (sizeof(T) == 4)
+            return _mm_set1_epi32(static_cast<int>(v));
+        else
+            return _mm_set1_epi64x(static_cast<long long>(v));
+    }
+
+    template<typename T>
+    static reg cmpeq(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm_castps_si128(_mm_cmpeq_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+        else if constexpr (std::is_same_v<T, double>)
+            return _mm_castpd_si128(_mm_cmpeq_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+        else if constexpr (sizeof(T) == 1)
+            return _mm_cmpeq_epi8(a, b);
+        else if constexpr (sizeof(T) == 2)
+            return _mm_cmpeq_epi16(a, b);
+        else if constexpr (sizeof(T) == 4)
+            return _mm_cmpeq_epi32(a, b);
+        else
+        {
+            // no cmpeq_epi64 before SSE4.1: both 32-bit halves have to match
+            const reg c = _mm_cmpeq_epi32(a, b);
+            return _mm_and_si128(c, _mm_shuffle_epi32(c, _MM_SHUFFLE(2, 3, 0, 1)));
+        }
+    }
+
+    static void store(void* p, reg a)
+    {
+        _mm_storeu_si128(static_cast<__m128i*>(p), a);
+    }
+    // lanes of mask set pick b, clear pick a (no blendv before SSE4.1)
+    static reg blend(reg a, reg b, reg mask)
+    {
+        return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+    }
+
+    // lane indices 0, 1, ... in lanes of sizeof(T) bytes
+    template<typename T>
+    static reg index_init()
+    {
+        if constexpr (sizeof(T) == 4)
+            return _mm_setr_epi32(0, 1, 2, 3);
+        else
+            return _mm_set_epi64x(1, 0);
+    }
+    template<typename T>
+    static reg index_add(reg a, reg b)
+    {
+        if constexpr (sizeof(T) == 4)
+            return _mm_add_epi32(a, b);
+        else
+            return _mm_add_epi64(a, b);
+    }
+    template<typename T>
+    static reg index_broadcast(std::size_t v)
+    {
+        if constexpr (sizeof(T) == 4)
+            return _mm_set1_epi32(static_cast<int>(v));
+        else
+            return _mm_set1_epi64x(static_cast<long long>(v));
+    }
+
+    // a < b for int32_t, float and double
+    template<typename T>
+    static reg cmplt(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm_castps_si128(_mm_cmplt_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+        else if constexpr (std::is_same_v<T, double>)
+            return _mm_castpd_si128(_mm_cmplt_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+        else
+            return _mm_cmpgt_epi32(b, a);
+    }
+
+    static reg zero()
+    {
+        return _mm_setzero_si128();
+    }
+    template<typename T>
+    static reg fadd(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+        else
+            return _mm_castpd_si128(_mm_add_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+    }
+    template<typename T>
+    static reg fsub(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm_castps_si128(_mm_sub_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+        else
+            return _mm_castpd_si128(_mm_sub_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+    }
+    // clears the sign bits
+    template<typename T>
+    static reg fabs(reg a)
+    {
+        return _mm_andnot_si128(broadcast<T>(T(-0.0)), a);
+    }
+    template<typename T>
+    static reg cmpge(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm_castps_si128(_mm_cmpge_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+        else
+            return _mm_castpd_si128(_mm_cmpge_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+    }
+    template<typename T>
+    static reg fmul(reg a, reg b)
+    {
+        if constexpr (std::is_same_v<T, float>)
+            return _mm_castps_si128(_mm_mul_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+        else
+            return _mm_castpd_si128(_mm_mul_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b)));
+    }
+
+    static reg bit_xor(reg a, reg b)
+    {
+        return _mm_xor_si128(a, b);
+    }
+    static reg add_u32(reg a, reg b)
+    {
+        return _mm_add_epi32(a, b);
+    }
+    static reg add_u64(reg a, reg b)
+    {
+        return _mm_add_epi64(a, b);
+    }
+    static reg srl_u32(reg a, int count)
+    {
+        return _mm_srli_epi32(a, count);
+    }
+    static reg srl_u64(reg a, int count)
+    {
+        return _mm_srli_epi64(a, count);
+    }
+    // 64-bit products of the low 32 bits of every 64-bit lane
+    static reg mul_u32_wide(reg a, reg b)
+    {
+        return _mm_mul_epu32(a, b);
+    }
+    // high and low halves of the 32x32 bit products of every 32-bit lane; b
+    // must hold the same value in both halves of each 64-bit lane
+    static void mul_hilo_u32(reg a, reg b, reg& hi, reg& lo)
+    {
+        const reg even = _mm_mul_epu32(a, b);
+        const reg odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), b);
+        const reg low_half = _mm_set1_epi64x(0xFFFFFFFF);
+        lo = _mm_or_si128(_mm_and_si128(even, low_half), _mm_slli_epi64(odd, 32));
+        hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(low_half, odd));
+    }
+};
+#endif
+
+
+/// === simd_find_first
+// Index of the first element equal to val in [data, data + n), n if none.
+// Four registers are compared per iteration and only inspected one by one
+// when the combined mask is not empty.
+template<typename T>
+std::size_t simd_find_first(const T* data, std::size_t n, T val)
+{
+    std::size_t i = 0;
+#if defined(SIMD_KERNELS_AVX2) || defined(SIMD_KERNELS_SSE2)
+    if constexpr (simd_arithmetic_v<T>)
+    {
+        using isa = simd_isa;
+        constexpr std::size_t per_reg = isa::width / sizeof(T);
+        const typename isa::reg needle = isa::template broadcast<T>(val);
+
+        for (; i + 4 * per_reg <= n; i += 4 * per_reg)
+        {
+            const typename isa::reg c0 = isa::template cmpeq<T>(isa::load(data + i), needle);
+            const typename isa::reg c1 = isa::template cmpeq<T>(isa::load(data + i + per_reg), needle);
+            const typename isa::reg c2 = isa::template cmpeq<T>(isa::load(data + i + 2 * per_reg), needle);
+            const typename isa::reg c3 = isa::template cmpeq<T>(isa::load(data + i + 3 * per_reg), needle);
+            if (isa::movemask(isa::bit_or(isa::bit_or(c0, c1), isa::bit_or(c2, c3))) == 0)
+                continue;
+            const typename isa::reg regs[4] = { c0, c1, c2, c3 };
+            for (std::size_t r = 0; r < 4; ++r)
+            {
+                const unsigned mask = isa::movemask(regs[r]);
+                if (mask)
+                    return i + r * per_reg + lowest_set_bit(mask) / sizeof(T);
+            }
+        }
+        for (; i + per_reg <= n; i += per_reg)
+        {
+            const unsigned mask = isa::movemask(isa::template cmpeq<T>(isa::load(data + i), needle));
+            if (mask)
+                return i + lowest_set_bit(mask) / sizeof(T);
+        }
+    }
+#endif
+    for (; i < n; ++i)
+        if (data[i] == val)
+            return i;
+    return n;
+}
+
+
+/// === simd_minmax_index
+// Positions of the smallest and the largest element of [data, data + n),
+// n > 0, in one pass. Each lane keeps its running min/max and where it was
+// seen; strict compares keep the earliest position per lane, and lanes
+// holding equal values resolve to the lowest position, so ties always go
+// to the lowest index. The order of NaNs is unspecified.
+template<typename T>
+std::pair<std::size_t, std::size_t> simd_minmax_index(const T* data, std::size_t n)
+{
+    std::size_t min_i = 0;
+    std::size_t max_i = 0;
+    std::size_t i = 1;
+#if defined(SIMD_KERNELS_AVX2) || defined(SIMD_KERNELS_SSE2)
+    if constexpr (simd_ordered_v<T>)
+    {
+        using isa = simd_isa;
+        using index_type = std::conditional_t<sizeof(T) == 4, std::uint32_t, std::uint64_t>;
+        constexpr std::size_t per_reg = isa::width / sizeof(T);
+        // 32-bit lane indices must not wrap
+        constexpr std::size_t max_piece = std::size_t(1) << 30;
+
+        if (n > max_piece)
+        {
+            std::pair<std::size_t, std::size_t> res = simd_minmax_index(data, max_piece);
+            for (std::size_t base = max_piece; base < n; base += max_piece)
+            {
+                const std::pair<std::size_t, std::size_t> piece = simd_minmax_index(data + base, std::min(max_piece, n - base));
+                if (data[base + piece.first] < data[res.first])
+                    res.first = base + piece.first;
+                if (data[res.second] < data[base + piece.second])
+                    res.second = base + piece.second;
+            }
+            return res;
+        }
+
+        if (n >= 2 * per_reg)
+        {
+            typename isa::reg min_v = isa::load(data);
+            typename isa::reg max_v = min_v;
+            typename isa::reg index = isa::template index_init<T>();
+            typename isa::reg min_index = index;
+            typename isa::reg max_index = index;
+            const typename isa::reg step = isa::template index_broadcast<T>(per_reg);
+
+            for (i = per_reg; i + per_reg <= n; i += per_reg)
+            {
+                index = isa::template index_add<T>(index, step);
+                const typename isa::reg x = isa::load(data + i);
+                const typename isa::reg lt = isa::template cmplt<T>(x, min_v);
+                min_v = isa::blend(min_v, x, lt);
+                min_index = isa::blend(min_index, index, lt);
+                const typename isa::reg gt = isa::template cmplt<T>(max_v, x);
+                max_v = isa::blend(max_v, x, gt);
+                max_index = isa::blend(max_index, index, gt);
+            }
+
+            index_type min_lanes[per_reg];
+            index_type max_lanes[per_reg];
+            isa::store(min_lanes, min_index);
+            isa::store(max_lanes, max_index);
+            min_i = min_lanes[0];
+            max_i = max_lanes[0];
+            for (std::size_t l = 1; l < per_reg; ++l)
+            {
+                const std::size_t mi = min_lanes[l];
+                if (data[mi] < data[min_i] || (!(data[min_i] < data[mi]) && mi < min_i))
+                    min_i = mi;
+                const std::size_t ma = max_lanes[l];
+                if (data[max_i] < data[ma] || (!(data[ma] < data[max_i]) && ma < max_i))
+                    max_i = ma;
+            }
+        }
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        if (data[i] < data[min_i])
+            min_i = i;
+        if (data[max_i] < data[i])
+            max_i = i;
+    }
+    return { min_i, max_i };
+}
+
+
+/// === compensated (Neumaier) summation
+// The value is sum + compensation; compensation collects the low-order bits
+// every addition to sum rounds away
+template<typename T>
+struct compensated_sum
+{
+    T sum;
+    T compensation;
+
+    T value() const
+    {
+        return sum + compensation;
+    }
+};
+
+template<typename T>
+inline void neumaier_add(compensated_sum<T>& acc, T x)
+{
+    const T t = acc.sum + x;
+    if (std::abs(acc.sum) >= std::abs(x))
+        acc.compensation += (acc.sum - t) + x;
+    else
+        acc.compensation += (x - t) + acc.sum;
+    acc.sum = t;
+}
+
+template<typename T>
+inline compensated_sum<T> neumaier_combine(compensated_sum<T> left, const compensated_sum<T>& right)
+{
+    neumaier_add(left, right.sum);
+    left.compensation += right.compensation;
+    return left;
+}
+
+// Element i always goes to accumulator i % 16, whatever the register width,
+// and the accumulators are folded in a fixed order, so SSE2, AVX2 and the
+// scalar loop give bitwise identical results for the same input.
+template<typename Iterator>
+auto neumaier_sum_n(Iterator first, std::size_t n)
+{
+    using T = typename std::iterator_traits<Iterator>::value_type;
+    constexpr std::size_t accumulators = 16;
+
+    compensated_sum<T> acc[accumulators] = {};
+    std::size_t i = 0;
+#if defined(SIMD_KERNELS_AVX2) || defined(SIMD_KERNELS_SSE2)
+    if constexpr (std::is_pointer_v<Iterator> && (std::is_same_v<T, float> || std::is_same_v<T, double>))
+    {
+        using isa = simd_isa;
+        constexpr std::size_t per_reg = isa::width / sizeof(T);
+        constexpr std::size_t regs = accumulators / per_reg;
+
+        typename isa::reg sums[regs];
+        typename isa::reg comps[regs];
+        for (std::size_t r = 0; r < regs; ++r)
+            sums[r] = comps[r] = isa::zero();
+
+        for (; i + accumulators <= n; i += accumulators)
+        {
+            // fully unrolled, otherwise -O2 keeps sums/comps in memory
+            SIMD_KERNELS_UNROLL
+            for (std::size_t r = 0; r < regs; ++r)
+            {
+                const typename isa::reg x = isa::load(first + i + r * per_reg);
+                const typename isa::reg t = isa::template fadd<T>(sums[r], x);
+                const typename isa::reg big = isa::template cmpge<T>(isa::template fabs<T>(sums[r]), isa::template fabs<T>(x));
+                const typename isa::reg err_small = isa::template fadd<T>(isa::template fsub<T>(x, t), sums[r]);
+                const typename isa::reg err_big = isa::template fadd<T>(isa::template fsub<T>(sums[r], t), x);
+                comps[r] = isa::template fadd<T>(comps[r], isa::blend(err_small, err_big, big));
+                sums[r] = t;
+            }
+        }
+
+        T sum_lanes[accumulators];
+        T comp_lanes[accumulators];
+        for (std::size_t r = 0; r < regs; ++r)
+        {
+            isa::store(sum_lanes + r * per_reg, sums[r]);
+            isa::store(comp_lanes + r * per_reg, comps[r]);
+        }
+        for (std::size_t j = 0; j < accumulators; ++j)
+            acc[j] = compensated_sum<T>{ sum_lanes[j], comp_lanes[j] };
+    }
+#endif
+    Iterator it = first;
+    std::advance(it, i);
+    for (; i + accumulators <= n; i += accumulators)
+        for (std::size_t j = 0; j < accumulators; ++j, ++it)
+            neumaier_add(acc[j], static_cast<T>(*it));
+
+    compensated_sum<T> res = acc[0];
+    for (std::size_t j = 1; j < accumulators; ++j)
+        res = neumaier_combine(res, acc[j]);
+    for (; i < n; ++i, ++it)
+        neumaier_add(res, static_cast<T>(*it));
+    return res;
+}
+
+
+/// === Philox4x32-10 counter-based generator
+// Random123's Philox: ten rounds of two 32x32 bit multiplies turn a 128-bit
+// counter and a 64-bit key into 128 random bits. Counter c and seed s give
+// the same four words no matter who asks and in which order, so any part of
+// the stream can be produced directly (O(1) skip-ahead).
+using philox_counter = std::array<std::uint32_t, 4>;
+
+std::uint32_t const philox_m0 = 0xD2511F53;
+std::uint32_t const philox_m1 = 0xCD9E8D57;
+std::uint32_t const philox_w0 = 0x9E3779B9;
+std::uint32_t const philox_w1 = 0xBB67AE85;
+
+inline philox_counter philox4x32_10(philox_counter c, std::uint64_t seed)
+{
+    std::uint32_t k0 = static_cast<std::uint32_t>(seed);
+    std::uint32_t k1 = static_cast<std::uint32_t>(seed >> 32);
+    for (int round = 0; round < 10; ++round)
+    {
+        const std::uint64_t p0 = std::uint64_t(philox_m0) * c[0];
+        const std::uint64_t p1 = std::uint64_t(philox_m1) * c[2];
+        c = { static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k0, static_cast<std::uint32_t>(p1),
+              static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k1, static_cast<std::uint32_t>(p0) };
+        k0 += philox_w0;
+        k1 += philox_w1;
+    }
+    return c;
+}
+
+// Fills out[0, groups * 32) from the counters 8 * first_group and up. A group
+// is 8 consecutive counters; word w of counter 8 * g + j goes to
+// out[32 * (g - first_group) + 8 * w + j]. The lanes of a register hold
+// consecutive counters, so this layout needs no shuffles at any register
+// width and SSE2, AVX2 and the scalar loop write identical buffers.
+inline void philox_fill(std::uint32_t* out, std::uint64_t first_group, std::size_t groups, std::uint64_t seed)
+{
+    constexpr std::size_t group_size = 8;
+    std::size_t g = 0;
+#if defined(SIMD_KERNELS_AVX2) || defined(SIMD_KERNELS_SSE2)
+    using isa = simd_isa;
+    constexpr std::size_t per_reg = isa::width / sizeof(std::uint32_t);
+    const typename isa::reg m0 = isa::broadcast<std::uint32_t>(philox_m0);
+    const typename isa::reg m1 = isa::broadcast<std::uint32_t>(philox_m1);
+    const typename isa::reg lanes = isa::index_init<std::uint32_t>();
+
+    for (; g < groups; ++g)
+    {
+        const std::uint64_t counter = (first_group + g) * group_size;
+        for (std::size_t half = 0; half < group_size; half += per_reg)
+        {
+            // groups start on multiples of 8, so the lanes never carry into c1
+            typename isa::reg c0 = isa::add_u32(isa::broadcast<std::uint32_t>(static_cast<std::uint32_t>(counter + half)), lanes);
+            typename isa::reg c1 = isa::broadcast<std::uint32_t>(static_cast<std::uint32_t>(counter >> 32));
+            typename isa::reg c2 = isa::zero();
+            typename isa::reg c3 = isa::zero();
+            std::uint32_t k0 = static_cast<std::uint32_t>(seed);
+            std::uint32_t k1 = static_cast<std::uint32_t>(seed >> 32);
+
+            SIMD_KERNELS_UNROLL
+            for (int round = 0; round < 10; ++round)
+            {
+                typename isa::reg hi0, lo0, hi1, lo1;
+                isa::mul_hilo_u32(c0, m0, hi0, lo0);
+                isa::mul_hilo_u32(c2, m1, hi1, lo1);
+                c0 = isa::bit_xor(isa::bit_xor(hi1, c1), isa::broadcast<std::uint32_t>(k0));
+                c1 = lo1;
+                c2 = isa::bit_xor(isa::bit_xor(hi0, c3), isa::broadcast<std::uint32_t>(k1));
+                c3 = lo0;
+                k0 += philox_w0;
+                k1 += philox_w1;
+            }
+
+            std::uint32_t* dest = out + g * 4 * group_size + half;
+            isa::store(dest, c0);
+            isa::store(dest + group_size, c1);
+            isa::store(dest + 2 * group_size, c2);
+            isa::store(dest + 3 * group_size, c3);
+        }
+    }
+#endif
+    for (; g < groups; ++g)
+    {
+        const std::uint64_t counter = (first_group + g) * group_size;
+        for (std::size_t j = 0; j < group_size; ++j)
+        {
+            const philox_counter c = philox4x32_10({ static_cast<std::uint32_t>(counter + j), static_cast<std::uint32_t>((counter + j) >> 32), 0, 0 }, seed);
+            for (std::size_t w = 0; w < 4; ++w)
+                out[g * 4 * group_size + w * group_size + j] = c[w];
+        }
+    }
+}
+
+
+/// === random bits to distributions
+// No rejection loops, so every element costs the same and vectorizes.
+
+// bits[i] = bits[i] * range / 2^64 (multiply-shift), uniform in [0, range)
+// for any range; range == 0 stands for 2^64 and keeps the bits. The bias is
+// below range / 2^64, so below 2^-32 for 32-bit ranges.
+inline void random_bits_to_range(std::uint64_t* bits, std::size_t n, std::uint64_t range)
+{
+    if (range == 0)
+        return;
+    std::size_t i = 0;
+#if defined(SIMD_KERNELS_AVX2) || defined(SIMD_KERNELS_SSE2)
+    if (range <= 0xFFFFFFFF)
+    {
+        // (hi * r + (lo * r >> 32)) >> 32 with two 32x32 bit multiplies
+        using isa = simd_isa;
+        constexpr std::size_t per_reg = isa::width / sizeof(std::uint64_t);
+        const typename isa::reg r = isa::broadcast<std::uint64_t>(range);
+        for (; i + per_reg <= n; i += per_reg)
+        {
+            const typename isa::reg x = isa::load(bits + i);
+            const typename isa::reg low = isa::srl_u64(isa::mul_u32_wide(x, r), 32);
+            const typename isa::reg high = isa::mul_u32_wide(isa::srl_u64(x, 32), r);
+            isa::store(bits + i, isa::srl_u64(isa::add_u64(high, low), 32));
+        }
+    }
+#endif
+    for (; i < n; ++i)
+    {
+#if defined(__SIZEOF_INT128__)
+        bits[i] = static_cast<std::uint64_t>((static_cast<unsigned __int128>(bits[i]) * range) >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        bits[i] = __umulh(bits[i], range);
+#else
+        const std::uint64_t x_lo = bits[i] & 0xFFFFFFFF, x_hi = bits[i] >> 32;
+        const std::uint64_t r_lo = range & 0xFFFFFFFF, r_hi = range >> 32;
+        const std::uint64_t mid = x_hi * r_lo + (x_lo * r_lo >> 32);
+        const std::uint64_t mid2 = x_lo * r_hi + (mid & 0xFFFFFFFF);
+        bits[i] = x_hi * r_hi + (mid >> 32) + (mid2 >> 32);
+#endif
+    }
+}
+
+// out[i] = a + u * width with u uniform in [0, 1). The top mantissa bits of
+// the input (23 of a uint32_t for float, 52 of a uint64_t for double) are
+// put under the exponent of 1.0, which gives a value in [1, 2), and 1 is
+// subtracted. a + u * width rounds to b only when width is tiny compared to a.
+template<typename T>
+void random_bits_to_real(const std::conditional_t<std::is_same_v<T, float>, std::uint32_t, std::uint64_t>* bits, std::size_t n, T a, T width, T* out)
+{
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "float or double only");
+    using bits_type = std::conditional_t<std::is_same_v<T, float>, std::uint32_t, std::uint64_t>;
+    constexpr int shift = std::is_same_v<T, float> ? 9 : 12;
+    constexpr bits_type one = std::is_same_v<T, float> ? bits_type(0x3F800000) : bits_type(0x3FF0000000000000);
+
+    std::size_t i = 0;
+#if defined(SIMD_KERNELS_AVX2) || defined(SIMD_KERNELS_SSE2)
+    using isa = simd_isa;
+    constexpr std::size_t per_reg = isa::width / sizeof(T);
+    const typename isa::reg one_bits = isa::broadcast<bits_type>(one);
+    const typename isa::reg one_value = isa::broadcast<T>(T(1));
+    const typename isa::reg a_value = isa::broadcast<T>(a);
+    const typename isa::reg w_value = isa::broadcast<T>(width);
+    for (const std::size_t simd_end = n - n % per_reg; i < simd_end; i += per_reg)
+    {
+        const typename isa::reg x = isa::load(bits + i);
+        const typename isa::reg mantissa = std::is_same_v<T, float> ? isa::srl_u32(x, shift) : isa::srl_u64(x, shift);
+        const typename isa::reg u = isa::template fsub<T>(isa::bit_or(mantissa, one_bits), one_value);
+        isa::store(out + i, isa::template fadd<T>(a_value, isa::template fmul<T>(u, w_value)));
+    }
+#endif
+    for (; i < n; ++i)
+    {
+        const bits_type mantissa = (bits[i] >> shift) | one;
+        T u;
+        std::memcpy(&u, &mantissa, sizeof(T));
+        out[i] = a + (u - T(1)) * width;
+    }
+}
@@ -0,0 +1,76 @@
+// stack_bench.cpp : push/pop contention on lockfree_stack against the
+// mutex-based threadsafe_stack, used as a shared free-list/work stack.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "Tvector.h"
+#include "lockfree_stack.h"
+
+
+/// === helpers
+// every thread pushes a value and pops one back; millions of pairs per second
+template<typename PopFunc, typename Stack>
+double throughput(Stack& stack, unsigned threads, std::size_t pairs_per_thread, PopFunc pop)
+{
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&] {
+            while (!go.load())
+                std::this_thread::yield();
+            for (std::size_t i = 0; i < pairs_per_thread; ++i)
+            {
+                stack.push(static_cast<int>(i));
+                pop(stack);
+            }
+        });
+    }
+
+    const auto t1 = std::chrono::steady_clock::now();
+    go.store(true);
+    for (std::thread& th : workers)
+        th.join();
+    const auto t2 = std::chrono::steady_clock::now();
+    return threads * pairs_per_thread / std::chrono::duration<double, std::micro>(t2 - t1).count();
+}
+
+
+int main()
+{
+    const std::size_t pairs = 200'000u;
+    const unsigned thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(10) << std::left << "threads" << std::setw(22) << "threadsafe_stack Mops"
+              << std::setw(20) << "lockfree_stack Mops" << "speedup\n";
+
+    for (unsigned threads : thread_counts)
+    {
+        threadsafe_stack<int> locked;
+        lockfree_stack<int> lockfree;
+        const double old_rate = throughput(locked, threads, pairs, [](threadsafe_stack<int>& s) {
+            int value;
+            try
+            {
+                s.pop(value);
+            }
+            catch (const empty_stack&)
+            {}
+        });
+        const double new_rate = throughput(lockfree, threads, pairs, [](lockfree_stack<int>& s) {
+            s.try_pop();
+        });
+        std::cout << std::setw(10) << threads << std::setw(22) << old_rate
+                  << std::setw(20) << new_rate << new_rate / old_rate << "x\n";
+    }
+
+    return 0;
+}
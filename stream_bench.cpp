@@ -0,0 +1,103 @@
+// stream_bench.cpp : the *_stream algorithms over a file of doubles, once
+// per stream_mode. The file is written chunk by chunk through an output
+// mapping, so no step holds the data in memory; the peak resident size is
+// printed at the end. Arguments: pool size, millions of records (default
+// 150), file name (default stream_bench.bin; the transform writes
+// <file>.out). Both files are removed afterwards.
+// GB/s counts the bytes of the input file once (read and write for
+// transform); a second pass mostly comes from the page cache.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include <sys/resource.h>
+
+#include "parallel_stream.h"
+
+
+/// === helpers
+template<typename Func>
+double seconds(Func fun)
+{
+    const auto t1 = std::chrono::steady_clock::now();
+    fun();
+    const auto t2 = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> sec = t2 - t1;
+    return sec.count();
+}
+
+double peak_resident_mb()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+// every chunk gets its own seed, generate_random_parallel restarts the stream
+void write_file(const std::string& path, std::size_t count)
+{
+    mapped_records<double> out(path, count);
+    const std::size_t chunk = stream_chunk_bytes / sizeof(double);
+    for (std::size_t offset = 0; offset < count; offset += chunk)
+    {
+        const std::size_t n = std::min(chunk, count - offset);
+        generate_random_parallel(out.data() + offset, out.data() + offset + n, 0.0, 1.0, offset / chunk);
+        out.release(offset, n);
+    }
+}
+
+void report(const char* name, double sec, double bytes)
+{
+    std::cout << std::setw(26) << std::left << name << std::fixed << std::setprecision(1)
+              << std::setw(12) << sec * 1000 << std::setw(10) << bytes / sec / 1e9 << std::defaultfloat << std::setprecision(6);
+}
+
+void run(const std::string& path, stream_mode mode)
+{
+    const record_stream<double> in(path, mode);
+    const double bytes = static_cast<double>(in.size() * sizeof(double));
+    std::cout << (mode == stream_mode::mapped ? "mapped" : "buffered") << '\n';
+
+    double sum = 0;
+    report("accumulate_stream", seconds([&] { sum = accumulate_stream(in, 0.0); }), bytes);
+    std::cout << "sum " << sum << '\n';
+
+    std::size_t found = 0;
+    report("find_stream (no match)", seconds([&] { found = find_stream(in, -1.0); }), bytes);
+    std::cout << (found == in.size() ? "not found" : "found?") << '\n';
+
+    std::size_t max_index = 0;
+    report("max_element_stream", seconds([&] { max_index = max_element_stream(in); }), bytes);
+    std::cout << "at " << max_index << '\n';
+
+    mapped_records<double> out(path + ".out", in.size());
+    report("transform_stream", seconds([&] { transform_stream(in, out, [](double x) { return x * 0.5 + 0.25; }); }), 2 * bytes);
+    std::cout << '\n';
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        thread_pool::set_size(static_cast<unsigned>(std::stoul(argv[1])));
+    const std::size_t count = (argc > 2 ? std::stoul(argv[2]) : 150) * 1'000'000 + 7;
+    const std::string path = argc > 3 ? argv[3] : "stream_bench.bin";
+    std::cout << "pool workers: " << thread_pool::instance().size() << " (+ calling thread), "
+              << count * sizeof(double) / (1 << 20) << " MiB file, "
+              << stream_chunk_bytes / (1 << 20) << " MiB chunks\n\n";
+
+    std::cout << std::setw(26) << std::left << "write" << std::fixed << std::setprecision(1)
+              << seconds([&] { write_file(path, count); }) * 1000 << " ms\n\n" << std::defaultfloat;
+    std::cout << std::setw(26) << std::left << "" << std::setw(12) << "ms" << std::setw(10) << "GB/s" << '\n';
+    run(path, stream_mode::mapped);
+    run(path, stream_mode::buffered);
+    std::cout << "peak resident " << std::fixed << std::setprecision(1) << peak_resident_mb() << " MiB\n";
+
+    std::remove(path.c_str());
+    std::remove((path + ".out").c_str());
+    return 0;
+}
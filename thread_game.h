@@ -4,8 +4,8 @@
 #include <vector>
 #include <random>
 #include <thread>
-#include <mutex>
-#include <condition_variable>
+
+#include "token_ring.h"
 
 struct rnd_uniform
 {
@@ -20,34 +20,27 @@ struct rnd_uniform
 	}
 };
 
+// Only the holder of the ring's token touches Quantity, so it needs no lock
 int Quantity;
-std::mutex Quantity_mtx;
 
 /// Using funtion
 
-void playre_thread(int player_id, std::condition_variable& cv_self, std::condition_variable& cv_next, rnd_uniform rnd)
+void playre_thread(int player_id, token_ring& ring, size_t slot, rnd_uniform rnd)
 {
-	while (true)
+	while (ring.wait_turn(slot))
 	{
+		if (Quantity == 1)
 		{
-			std::unique_lock<std::mutex> lock(Quantity_mtx);
-			cv_self.wait(lock);
-
-			if (Quantity < 1)
-				break;
-			if (Quantity == 1)
-			{
-				std::cout << "Looser:\t" << std::this_thread::get_id() << "\t#" << player_id << '\n';
-				Quantity = 0;
-				break;
-			}
-			auto d = rnd(1, (Quantity <= 10) ? Quantity / 2 : 10);
-			std::cout << std::this_thread::get_id() << "\t#" << player_id << " Quantity: " << Quantity << " - " << d << '\n';
-			Quantity -= d;
+			std::cout << "Looser:\t" << std::this_thread::get_id() << "\t#" << player_id << '\n';
+			Quantity = 0;
+			ring.stop();
+			break;
 		}
-		cv_next.notify_one();
+		auto d = rnd(1, (Quantity <= 10) ? Quantity / 2 : 10);
+		std::cout << std::this_thread::get_id() << "\t#" << player_id << " Quantity: " << Quantity << " - " << d << '\n';
+		Quantity -= d;
+		ring.pass(slot);
 	}
-	cv_next.notify_one();
 }
 
 
@@ -57,16 +50,15 @@ void game_via_function()
 	std::random_device rnd_dev;
 	rnd_uniform rnd_gen(rnd_dev);
 	int players_num = 3;
-	std::vector<std::condition_variable> arr_cv(players_num);
+	token_ring ring(players_num);
 	std::vector<std::thread> players;
 	for (size_t i = 0; i < players_num; i++)
 	{
-		players.emplace_back(playre_thread, i + 1, std::ref(arr_cv[i]), std::ref(arr_cv[(i + 1) % players_num]), rnd_gen);
+		players.emplace_back(playre_thread, i + 1, std::ref(ring), i, rnd_gen);
 	}
 
 	std::cout << "Game started!\n";
-	std::this_thread::sleep_for(std::chrono::milliseconds(500));
-	arr_cv[0].notify_one();
+	ring.start();
 
 	for (std::thread& th : players)
 		th.join();
@@ -78,38 +70,32 @@ class Player
 {
 private:
 	size_t id;
-	std::condition_variable* cv_self;
-	std::condition_variable* cv_next;
+	token_ring* ring;
+	size_t slot;
 	rnd_uniform rnd;
 	std::thread t;
 
 	void game()
 	{
-		while (true)
+		while (ring->wait_turn(slot))
 		{
+			if (Quantity == 1)
 			{
-				std::unique_lock<std::mutex> lock(Quantity_mtx);
-				cv_self->wait(lock);
-				if (Quantity < 1)
-					break;
-				if (Quantity == 1)
-				{
-					std::cout << "Looser:\t" << std::this_thread::get_id() << "\t#" << id << '\n';
-					Quantity = 0;
-					break;
-				}
-				auto d = rnd(1, (Quantity <= 10) ? Quantity / 2 : 10);
-				std::cout << std::this_thread::get_id() << "\t#" << id << " Quantity: " << Quantity << " -" << d << '\n';
-				Quantity -= d;
+				std::cout << "Looser:\t" << std::this_thread::get_id() << "\t#" << id << '\n';
+				Quantity = 0;
+				ring->stop();
+				break;
 			}
-			cv_next->notify_one();
+			auto d = rnd(1, (Quantity <= 10) ? Quantity / 2 : 10);
+			std::cout << std::this_thread::get_id() << "\t#" << id << " Quantity: " << Quantity << " -" << d << '\n';
+			Quantity -= d;
+			ring->pass(slot);
 		}
-		cv_next->notify_one();
 	}
 
 public:
-	Player(size_t ind, std::condition_variable* cv_current, std::condition_variable* cv_nextplayer, rnd_uniform gen) :
-		id(ind), cv_self(cv_current), cv_next(cv_nextplayer), rnd(gen)
+	Player(size_t ind, token_ring* ring_, size_t slot_, rnd_uniform gen) :
+		id(ind), ring(ring_), slot(slot_), rnd(gen)
 	{
 		// DDon't run a thread here if the object will be copied or moved, i.e. the "this" address will change.
 		// t = std::thread(&Player::game, this);
@@ -142,21 +128,20 @@ void game_via_object()
 	std::random_device rnd_dev;
 	rnd_uniform rnd_gen(rnd_dev);
 	int players_num = 3;
-	std::vector<std::condition_variable> arr_cv(players_num);
+	token_ring ring(players_num);
 	{
 		std::vector<Player> players;
 		//players.reserve(players_num); 
 		for (size_t i = 0; i < players_num; i++)
 		{
-			players.emplace_back(i + 1, &arr_cv[i], &arr_cv[(i + 1) % players_num], rnd_gen);
+			players.emplace_back(i + 1, &ring, i, rnd_gen);
 		}
 
 		std::cout << "Game started!\n";
 		for (size_t i = 0; i < players_num; i++)
 			players[i].run();
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(500));
-		arr_cv[0].notify_one();
+		ring.start();
 	}
 }
 
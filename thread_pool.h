@@ -0,0 +1,403 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "numa_topology.h"
+
+
+/// === function_wrapper
+// std::function needs a copyable target, std::packaged_task is move-only
+class function_wrapper
+{
+private:
+    struct impl_base
+    {
+        virtual void call() = 0;
+        virtual ~impl_base() {}
+    };
+
+    template<typename F>
+    struct impl_type : impl_base
+    {
+        F f;
+        template<typename G>
+        explicit impl_type(G&& g) : f(std::forward<G>(g)) {}
+        void call() { f(); }
+    };
+
+    std::unique_ptr<impl_base> impl;
+
+public:
+    function_wrapper() = default;
+
+    // an lvalue callable is copied, not moved from; a function_wrapper
+    // lvalue goes to the deleted copy constructor
+    template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, function_wrapper>>>
+    function_wrapper(F&& f) : impl(new impl_type<std::decay_t<F>>(std::forward<F>(f)))
+    {}
+
+    function_wrapper(function_wrapper&& other) noexcept : impl(std::move(other.impl))
+    {}
+    function_wrapper& operator=(function_wrapper&& other) noexcept
+    {
+        impl = std::move(other.impl);
+        return *this;
+    }
+    function_wrapper(const function_wrapper&) = delete;
+    function_wrapper& operator=(const function_wrapper&) = delete;
+
+    void operator()()
+    {
+        impl->call();
+    }
+};
+
+
+/// === work_stealing_queue
+// Owner pushes and pops at the front (LIFO, still hot in cache),
+// other workers steal from the back, where the biggest pieces are
+class work_stealing_queue
+{
+private:
+    std::deque<function_wrapper> the_queue;
+    mutable std::mutex the_mutex;
+
+public:
+    work_stealing_queue() {}
+    work_stealing_queue(const work_stealing_queue&) = delete;
+    work_stealing_queue& operator=(const work_stealing_queue&) = delete;
+
+    void push(function_wrapper data)
+    {
+        std::lock_guard<std::mutex> lock(the_mutex);
+        the_queue.push_front(std::move(data));
+    }
+    bool empty() const
+    {
+        std::lock_guard<std::mutex> lock(the_mutex);
+        return the_queue.empty();
+    }
+    bool try_pop(function_wrapper& res)
+    {
+        std::lock_guard<std::mutex> lock(the_mutex);
+        if (the_queue.empty())
+            return false;
+        res = std::move(the_queue.front());
+        the_queue.pop_front();
+        return true;
+    }
+    bool try_steal(function_wrapper& res)
+    {
+        std::lock_guard<std::mutex> lock(the_mutex);
+        if (the_queue.empty())
+            return false;
+        res = std::move(the_queue.back());
+        the_queue.pop_back();
+        return true;
+    }
+};
+
+
+/// === thread_pool
+// Process-wide pool shared by the *_parallel algorithms. Workers are started
+// on the first call to instance(); the calling thread always takes part in
+// the work, so the default size is hardware_concurrency() - 1.
+// Tasks submitted from a worker go to that worker's own deque, tasks from
+// any other thread go to the shared queue; idle workers steal.
+class thread_pool
+{
+private:
+    std::atomic<bool> done;
+    std::atomic<std::size_t> pending;    // tasks sitting in any of the queues
+    std::atomic<unsigned> sleepers;
+    std::mutex sleep_mut;
+    std::condition_variable work_cond;
+    std::mutex pool_mut;
+    std::deque<function_wrapper> pool_work_queue;
+    std::vector<std::unique_ptr<work_stealing_queue>> queues;
+    std::vector<std::thread> threads;
+
+    inline static thread_local thread_pool* local_pool = nullptr;
+    inline static thread_local work_stealing_queue* local_work_queue = nullptr;
+    inline static thread_local unsigned my_index = 0;
+
+    // -1 until set_size() is called
+    static std::atomic<long>& requested_size()
+    {
+        static std::atomic<long> size{ -1 };
+        return size;
+    }
+
+    static std::atomic<bool>& started()
+    {
+        static std::atomic<bool> flag{ false };
+        return flag;
+    }
+
+    static std::atomic<bool>& pinning()
+    {
+        static std::atomic<bool> flag{ false };
+        return flag;
+    }
+
+    bool pop_task_from_local_queue(function_wrapper& task)
+    {
+        return local_pool == this && local_work_queue->try_pop(task);
+    }
+
+    bool pop_task_from_pool_queue(function_wrapper& task)
+    {
+        std::lock_guard<std::mutex> lk(pool_mut);
+        if (pool_work_queue.empty())
+            return false;
+        task = std::move(pool_work_queue.front());
+        pool_work_queue.pop_front();
+        return true;
+    }
+
+    bool pop_task_from_other_thread_queue(function_wrapper& task)
+    {
+        for (unsigned i = 0; i < queues.size(); ++i)
+        {
+            const unsigned index = (my_index + i + 1) % queues.size();
+            if (queues[index]->try_steal(task))
+                return true;
+        }
+        return false;
+    }
+
+    // Both sides go through seq_cst atomics: either the submitter sees the
+    // sleeper, or the sleeper sees the pending task, so no wakeup is lost
+    void wake_one()
+    {
+        if (sleepers.load() == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lk(sleep_mut);
+        }
+        work_cond.notify_one();
+    }
+
+    void sleep_until_work()
+    {
+        std::unique_lock<std::mutex> lk(sleep_mut);
+        ++sleepers;
+        work_cond.wait(lk, [this] { return done || pending.load() != 0; });
+        --sleepers;
+    }
+
+    void worker_thread(unsigned index)
+    {
+        if (pinning())
+        {
+            const std::vector<unsigned>& cpus = numa_topology::instance().cpus();
+            pin_current_thread(cpus[(index + 1) % cpus.size()]);
+        }
+        local_pool = this;
+        my_index = index;
+        local_work_queue = queues[index].get();
+        while (!done)
+        {
+            if (!run_pending_task())
+                sleep_until_work();
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lk(sleep_mut);
+            done = true;
+        }
+        work_cond.notify_all();
+        for (std::thread& th : threads)
+            if (th.joinable())
+                th.join();
+    }
+
+public:
+    explicit thread_pool(unsigned thread_count) : done(false), pending(0), sleepers(0)
+    {
+        try
+        {
+            for (unsigned i = 0; i < thread_count; ++i)
+                queues.push_back(std::make_unique<work_stealing_queue>());
+            threads.reserve(thread_count);
+            for (unsigned i = 0; i < thread_count; ++i)
+                threads.emplace_back(&thread_pool::worker_thread, this, i);
+        }
+        catch (...)
+        {
+            stop();
+            throw;
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool()
+    {
+        stop();
+    }
+
+    static unsigned default_size()
+    {
+        const unsigned hardware_threads = std::thread::hardware_concurrency();
+        return (hardware_threads > 1) ? hardware_threads - 1 : 1;
+    }
+
+    // Number of workers for the shared pool; 0 runs everything on the calling
+    // thread. Only has an effect before the first call to instance();
+    // returns false once the pool is running.
+    static bool set_size(unsigned thread_count)
+    {
+        if (started())
+            return false;
+        requested_size() = thread_count;
+        return true;
+    }
+
+    // Pins worker i to the (i + 1)-th CPU of numa_topology::cpus(), which
+    // lists the CPUs node by node, so workers fill one node before the next.
+    // The first CPU is left to the calling thread (pin_current_thread).
+    // Like set_size, only has an effect before the first call to instance().
+    static bool set_pinning(bool pin)
+    {
+        if (started())
+            return false;
+        pinning() = pin;
+        return true;
+    }
+
+    static thread_pool& instance()
+    {
+        static thread_pool pool((started() = true, requested_size() >= 0 ? static_cast<unsigned>(requested_size().load()) : default_size()));
+        return pool;
+    }
+
+    std::size_t size() const
+    {
+        return threads.size();
+    }
+
+    template<typename FunctionType>
+    std::future<std::invoke_result_t<FunctionType>> submit(FunctionType f)
+    {
+        using result_type = std::invoke_result_t<FunctionType>;
+        std::packaged_task<result_type()> task(std::move(f));
+        std::future<result_type> res(task.get_future());
+        if (local_pool == this)
+        {
+            local_work_queue->push(std::move(task));
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lk(pool_mut);
+            pool_work_queue.emplace_back(std::move(task));
+        }
+        ++pending;
+        wake_one();
+        return res;
+    }
+
+    // Runs one queued task on the calling thread: own deque first,
+    // then the shared queue, then steals from the other workers
+    bool run_pending_task()
+    {
+        function_wrapper task;
+        if (pop_task_from_local_queue(task) ||
+            pop_task_from_pool_queue(task) ||
+            pop_task_from_other_thread_queue(task))
+        {
+            --pending;
+            task();
+            return true;
+        }
+        return false;
+    }
+
+    // Helps with queued work until f is ready, so a task that waits on
+    // its own sub-tasks never starves the pool (nested calls don't deadlock)
+    template<typename T>
+    void wait(const std::future<T>& f)
+    {
+        while (f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (!run_pending_task())
+                std::this_thread::yield();
+        }
+    }
+
+    template<typename T>
+    T get(std::future<T>& f)
+    {
+        wait(f);
+        return f.get();
+    }
+};
+
+
+/// === task_group
+// Fork/join on the shared pool: spawn() forks a task, wait() joins all of
+// them, running queued work (usually the group's own tasks) meanwhile
+class task_group
+{
+private:
+    thread_pool& pool;
+    std::vector<std::future<void>> futures;
+
+public:
+    explicit task_group(thread_pool& pool_ = thread_pool::instance()) : pool(pool_)
+    {}
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    ~task_group()
+    {
+        for (std::future<void>& f : futures)
+            if (f.valid())
+                pool.wait(f);
+    }
+
+    template<typename FunctionType>
+    void spawn(FunctionType f)
+    {
+        futures.push_back(pool.submit(std::move(f)));
+    }
+
+    // Rethrows the first exception, but only once every task has finished
+    void wait()
+    {
+        std::exception_ptr error;
+        for (std::future<void>& f : futures)
+        {
+            pool.wait(f);
+            try
+            {
+                f.get();
+            }
+            catch (...)
+            {
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+        futures.clear();
+        if (error)
+            std::rethrow_exception(error);
+    }
+};
+
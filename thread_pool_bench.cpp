@@ -0,0 +1,153 @@
+// thread_pool_bench.cpp : per-call latency of the pooled *_parallel algorithms
+// against the previous thread-per-call implementation, plus a transform whose
+// element cost depends on the data (load balancing of the recursive split).
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <numeric>
+#include <cmath>
+
+#include "parallel_alghr.h"
+
+
+/// === previous implementation: hardware_concurrency() - 1 new threads per call
+template<typename Iterator, typename T>
+T accumulate_thread_per_call(Iterator first, Iterator last, T init)
+{
+    unsigned long const length = std::distance(first, last);
+    if (!length)
+        return init;
+    unsigned long const min_per_thread = 250;
+    unsigned long const max_threads = (length + min_per_thread - 1) / min_per_thread;
+    unsigned long const hardware_threads = std::thread::hardware_concurrency();
+    unsigned long const num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
+    unsigned long const block_size = length / num_threads;
+
+    std::vector<T> results(num_threads);
+    std::vector<std::thread> threads(num_threads - 1);
+    Iterator block_start = first;
+    for (size_t i = 0; i < (num_threads - 1); ++i)
+    {
+        Iterator block_end = block_start;
+        std::advance(block_end, block_size);
+        threads[i] = std::thread([block_start, block_end, &res = results[i]] { res = std::accumulate(block_start, block_end, res); });
+        block_start = block_end;
+    }
+    results[num_threads - 1] = std::accumulate(block_start, last, results[num_threads - 1]);
+    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+    return std::accumulate(results.begin(), results.end(), init);
+}
+
+template<typename InputIt, typename OutputIt, typename UnaryOperation>
+void transform_thread_per_call(InputIt first1, InputIt last1, OutputIt d_first, UnaryOperation op)
+{
+    unsigned long const length = std::distance(first1, last1);
+    if (!length)
+        return;
+    unsigned long const min_per_thread = 250;
+    unsigned long const max_threads = (length + min_per_thread - 1) / min_per_thread;
+    unsigned long const hardware_threads = std::thread::hardware_concurrency();
+    unsigned long const num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
+    unsigned long const block_size = length / num_threads;
+
+    std::vector<std::thread> threads(num_threads - 1);
+    InputIt block_start = first1;
+    OutputIt result_start = d_first;
+    for (unsigned long i = 0; i < (num_threads - 1); ++i)
+    {
+        InputIt block_end = block_start;
+        std::advance(block_end, block_size);
+        threads[i] = std::thread(std::transform<InputIt, OutputIt, UnaryOperation>, block_start, block_end, result_start, op);
+        block_start = block_end;
+        std::advance(result_start, block_size);
+    }
+    std::transform(block_start, last1, result_start, op);
+    std::for_each(threads.begin(), threads.end(), std::mem_fn(&std::thread::join));
+}
+
+
+/// === helpers
+// median wall time of one call, in microseconds
+template<typename Func>
+double median_us(std::size_t repetitions, Func f)
+{
+    std::vector<double> samples;
+    samples.reserve(repetitions);
+    f(); // warmup, also starts the shared pool
+    for (std::size_t i = 0; i < repetitions; ++i)
+    {
+        const auto t1 = std::chrono::steady_clock::now();
+        f();
+        const auto t2 = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::micro>(t2 - t1).count());
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}
+
+double sqrtd(double val)
+{
+    return sqrt(val);
+}
+
+// cost grows with the value, so equal-sized blocks take unequal time
+double skewed(double val)
+{
+    double r = val;
+    for (int i = 0; i < static_cast<int>(val); ++i)
+        r = sqrt(r + i);
+    return r;
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        thread_pool::set_size(static_cast<unsigned>(std::stoul(argv[1])));
+
+    const std::size_t sizes[] = { 1'000u, 100'000u, 150'000'007u };
+    const std::size_t repetitions[] = { 2000u, 200u, 5u };
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "pool workers: " << thread_pool::instance().size() << " (+ calling thread)\n";
+    std::cout << std::setw(12) << std::left << "size" << std::setw(28) << "algorithm"
+              << std::setw(18) << "thread/call us" << std::setw(18) << "pool us" << "speedup\n";
+
+    for (std::size_t s = 0; s < 3; ++s)
+    {
+        std::vector<double> v(sizes[s], 0.1);
+        std::vector<double> out(sizes[s]);
+        volatile double sink = 0;
+
+        const double acc_old = median_us(repetitions[s], [&] { sink = accumulate_thread_per_call(v.cbegin(), v.cend(), 0.0); });
+        const double acc_new = median_us(repetitions[s], [&] { sink = accumulate_parallel(v.cbegin(), v.cend(), 0.0); });
+        std::cout << std::setw(12) << sizes[s] << std::setw(28) << "accumulate_parallel"
+                  << std::setw(18) << acc_old << std::setw(18) << acc_new << acc_old / acc_new << "x\n";
+
+        const double tr_old = median_us(repetitions[s], [&] { transform_thread_per_call(v.cbegin(), v.cend(), out.begin(), sqrtd); });
+        const double tr_new = median_us(repetitions[s], [&] { transform_parallel(v.cbegin(), v.cend(), out.begin(), sqrtd); });
+        std::cout << std::setw(12) << sizes[s] << std::setw(28) << "transform_parallel"
+                  << std::setw(18) << tr_old << std::setw(18) << tr_new << tr_old / tr_new << "x\n";
+        (void)sink;
+    }
+
+    {
+        const std::size_t size = 200'000u;
+        std::vector<double> v(size);
+        for (std::size_t i = 0; i < size; ++i)
+            v[i] = 200.0 * i / size;
+        std::vector<double> out(size);
+        const double tr_old = median_us(20, [&] { transform_thread_per_call(v.cbegin(), v.cend(), out.begin(), skewed); });
+        const double tr_new = median_us(20, [&] { transform_parallel(v.cbegin(), v.cend(), out.begin(), skewed); });
+        std::cout << std::setw(12) << size << std::setw(28) << "transform_parallel (skewed)"
+                  << std::setw(18) << tr_old << std::setw(18) << tr_new << tr_old / tr_new << "x\n";
+    }
+
+    return 0;
+}
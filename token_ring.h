@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "cache_line.h"
+
+
+/// === token_ring
+// Baton passing between participants 0 .. size() - 1, each on its own
+// thread: wait_turn(i) blocks until i holds the token, pass(i) hands it to
+// i + 1 (pass_to to anyone). There is no shared lock, every participant
+// sleeps on the state word of its own slot (a futex on Linux,
+// std::atomic::wait elsewhere), and a handoff touches only the slot of the
+// receiver. The state is a value, not an event, so a token passed before
+// the receiver waits is not lost and a spurious wakeup just waits again.
+// The token orders everything the holders do: what one holder wrote before
+// pass is visible to the next after its wait_turn.
+// stop() wakes everybody; wait_turn then returns false, and passes made
+// after stop are ignored.
+class token_ring
+{
+private:
+    // idle -> sleeping: set by the waiter just before it goes to sleep, so
+    // a handoff only pays for the wake syscall when somebody sleeps
+    enum : std::uint32_t { idle = 0, sleeping = 1, holding = 2, stopped = 3 };
+
+    struct alignas(cache_line_size) slot
+    {
+        std::atomic<std::uint32_t> state{ idle };
+    };
+
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "futex needs a plain 32-bit word");
+
+    std::unique_ptr<slot[]> slots;
+    std::size_t count;
+    unsigned spin;
+
+    static void sleep_on(std::atomic<std::uint32_t>& word, std::uint32_t expected)
+    {
+#if defined(__linux__) && defined(SYS_futex)
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#elif defined(__cpp_lib_atomic_wait)
+        word.wait(expected, std::memory_order_acquire);
+#else
+        (void)word;
+        (void)expected;
+        std::this_thread::yield();
+#endif
+    }
+
+    static void wake(std::atomic<std::uint32_t>& word)
+    {
+#if defined(__linux__) && defined(SYS_futex)
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#elif defined(__cpp_lib_atomic_wait)
+        word.notify_one();
+#else
+        (void)word;
+#endif
+    }
+
+    void give(std::size_t i, std::uint32_t value)
+    {
+        std::atomic<std::uint32_t>& state = slots[i].state;
+        std::uint32_t old = state.load(std::memory_order_relaxed);
+        do
+        {
+            if (old == stopped)
+                return;
+        } while (!state.compare_exchange_weak(old, value, std::memory_order_acq_rel, std::memory_order_relaxed));
+        if (old == sleeping)
+            wake(state);
+    }
+
+    // the token is only ever given back to i after i has passed it on, so
+    // the slot can only have changed to stopped since it was read; a plain
+    // store of idle would overwrite that and sleep through the stop
+    bool take(std::size_t i, std::uint32_t state)
+    {
+        if (state == stopped)
+            return false;
+        return slots[i].state.compare_exchange_strong(state, idle, std::memory_order_relaxed);
+    }
+
+public:
+    // A waiter first re-checks its slot spin times (yielding in between)
+    // before it sleeps; that saves the futex round trip when the token
+    // comes back quickly, which only happens with a spare core
+    static unsigned default_spin()
+    {
+        return std::thread::hardware_concurrency() > 1 ? 64 : 0;
+    }
+
+    explicit token_ring(std::size_t participants, unsigned spin_ = default_spin())
+        : slots(new slot[participants]), count(participants), spin(spin_)
+    {}
+
+    token_ring(const token_ring&) = delete;
+    token_ring& operator=(const token_ring&) = delete;
+
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    // hands the first token out; may come before or after the waits
+    void start(std::size_t first = 0)
+    {
+        give(first, holding);
+    }
+
+    bool wait_turn(std::size_t i)
+    {
+        std::atomic<std::uint32_t>& state = slots[i].state;
+        for (unsigned k = 0; k < spin; ++k)
+        {
+            const std::uint32_t s = state.load(std::memory_order_acquire);
+            if (s >= holding)
+                return take(i, s);
+            std::this_thread::yield();
+        }
+        while (true)
+        {
+            std::uint32_t s = state.load(std::memory_order_acquire);
+            if (s >= holding)
+                return take(i, s);
+            if (s == idle && !state.compare_exchange_weak(s, sleeping, std::memory_order_acquire))
+                continue;
+            sleep_on(state, sleeping);
+        }
+    }
+
+    void pass(std::size_t i)
+    {
+        give(i + 1 == count ? 0 : i + 1, holding);
+    }
+
+    void pass_to(std::size_t j)
+    {
+        give(j, holding);
+    }
+
+    void stop()
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            give(i, stopped);
+    }
+};
@@ -0,0 +1,124 @@
+// token_ring_bench.cpp : handoff latency around a ring of threads, one
+// thread per participant, token_ring against the scheme thread_game used
+// before (one global mutex, a condition_variable per player; here with a
+// turn predicate, without it the ring can stall). A hop is one pass of the
+// token to the next thread. Arguments: hops per run (default 200000), then
+// "spin" to let token_ring spin before it sleeps even on a single core.
+//
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+
+#include "token_ring.h"
+
+
+/// === helpers
+struct ring_result
+{
+    double ns_per_hop;
+    double hops_per_sec;
+};
+
+template<typename Body, typename Start>
+ring_result run_ring(std::size_t participants, std::size_t hops, Body body, Start start)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(participants);
+    for (std::size_t i = 0; i < participants; ++i)
+        threads.emplace_back(body, i);
+    const auto t1 = std::chrono::steady_clock::now();
+    start();
+    for (std::thread& th : threads)
+        th.join();
+    const auto t2 = std::chrono::steady_clock::now();
+    const std::chrono::duration<double> sec = t2 - t1;
+    return { sec.count() * 1e9 / hops, hops / sec.count() };
+}
+
+ring_result bench_token_ring(std::size_t participants, std::size_t hops, unsigned spin)
+{
+    token_ring ring(participants, spin);
+    std::size_t done = 0;    // only the holder touches it
+    return run_ring(participants, hops, [&](std::size_t i)
+    {
+        while (ring.wait_turn(i))
+        {
+            if (++done == hops)
+            {
+                ring.stop();
+                return;
+            }
+            ring.pass(i);
+        }
+    }, [&] { ring.start(); });
+}
+
+ring_result bench_mutex_cv(std::size_t participants, std::size_t hops)
+{
+    std::mutex mut;
+    std::vector<std::condition_variable> cvs(participants);
+    std::size_t turn = participants;    // nobody until start
+    bool finished = false;
+    std::size_t done = 0;
+    return run_ring(participants, hops, [&](std::size_t i)
+    {
+        const std::size_t next = (i + 1) % participants;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mut);
+                cvs[i].wait(lock, [&] { return turn == i || finished; });
+                if (finished)
+                    return;
+                if (++done == hops)
+                {
+                    finished = true;
+                    lock.unlock();
+                    for (std::condition_variable& cv : cvs)
+                        cv.notify_one();
+                    return;
+                }
+                turn = next;
+            }
+            cvs[next].notify_one();
+        }
+    }, [&] {
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            turn = 0;
+        }
+        cvs[0].notify_one();
+    });
+}
+
+
+int main(int argc, char* argv[])
+{
+    const std::size_t hops = argc > 1 ? std::stoul(argv[1]) : 200'000;
+    const unsigned spin = (argc > 2 && std::string(argv[2]) == "spin") ? 64 : token_ring::default_spin();
+    std::cout << "hardware threads: " << std::thread::hardware_concurrency() << ", hops per run: " << hops
+              << ", token_ring spin: " << spin << "\n\n";
+
+    std::cout << std::setw(14) << std::left << "participants" << std::setw(20) << "ring"
+              << std::setw(14) << "ns/hop" << "Mhops/s\n";
+    for (std::size_t participants : { 2, 3, 16, 256, 4096 })
+    {
+        const ring_result token = bench_token_ring(participants, hops, spin);
+        const ring_result locked = bench_mutex_cv(participants, hops);
+        std::cout << std::fixed << std::setprecision(1)
+                  << std::setw(14) << participants << std::setw(20) << "token_ring"
+                  << std::setw(14) << token.ns_per_hop << std::setprecision(3) << token.hops_per_sec / 1e6 << '\n'
+                  << std::setprecision(1)
+                  << std::setw(14) << "" << std::setw(20) << "mutex + cv"
+                  << std::setw(14) << locked.ns_per_hop << std::setprecision(3) << locked.hops_per_sec / 1e6 << '\n'
+                  << std::defaultfloat;
+    }
+
+    return 0;
+}
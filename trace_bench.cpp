@@ -0,0 +1,83 @@
+// trace_bench.cpp : per-call instrumentation of a few *_parallel calls on
+// 150M elements. Build it with -DPARALLEL_TRACE=1 (for every translation
+// unit of the program); without it the hooks compile away and only the
+// timings are printed. Arguments: pool size, then the Chrome trace file
+// (default trace.json; open it in chrome://tracing or ui.perfetto.dev).
+//
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include "parallel_alghr.h"
+
+
+/// === helpers
+void print_calls()
+{
+    std::cout << std::left << std::setw(34) << "call" << std::right << std::setw(11) << "wall us" << std::setw(8) << "blocks"
+              << std::setw(10) << "blk min" << std::setw(10) << "blk max" << std::setw(6) << "thr" << std::setw(8) << "imbal"
+              << std::setw(11) << "spawn max" << std::setw(11) << "join us" << std::setw(14) << "cycles" << std::setw(12) << "LLC miss" << '\n';
+    for (const par_trace::call_stats& c : par_trace::calls())
+    {
+        std::cout << std::left << std::setw(34) << c.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(11) << c.wall_us << std::setw(8) << c.blocks
+                  << std::setw(10) << c.block_min_us << std::setw(10) << c.block_max_us << std::setw(6) << c.threads
+                  << std::setprecision(2) << std::setw(8) << c.imbalance << std::setprecision(1)
+                  << std::setw(11) << c.spawn_delay_max_us << std::setw(11) << c.join_wait_us;
+        if (c.counters)
+            std::cout << std::setw(14) << c.cycles << std::setw(12) << c.llc_misses;
+        else
+            std::cout << std::setw(14) << "-" << std::setw(12) << "-";
+        std::cout << '\n' << std::defaultfloat;
+    }
+}
+
+template<typename Func>
+void timed(const char* name, Func fun)
+{
+    const auto t1 = std::chrono::steady_clock::now();
+    fun();
+    const auto t2 = std::chrono::steady_clock::now();
+    const std::chrono::duration<double, std::milli> ms = t2 - t1;
+    std::cout << std::setw(34) << std::left << name << ms.count() << " ms\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        thread_pool::set_size(static_cast<unsigned>(std::stoul(argv[1])));
+    const std::string trace_file = argc > 2 ? argv[2] : "trace.json";
+    std::cout << "pool workers: " << thread_pool::instance().size() << " (+ calling thread), tracing "
+              << (par_trace::enabled ? "on" : "off") << ", counters "
+              << (par_trace::enable_counters(true) ? "on" : "off") << "\n\n";
+
+    const size_t data_size = 150'000'007u;
+    std::vector<double> v(data_size);
+    std::vector<double> out(data_size);
+    generate_random_parallel(v.begin(), v.end(), 0.0, 1.0);
+    // the first calls tune the grain size, trace the steady state
+    accumulate_parallel(v.cbegin(), v.cend(), 0.0);
+    transform_parallel(v.cbegin(), v.cend(), out.begin(), [](double x) { return x * x; });
+    par_trace::clear();
+
+    double sum = 0;
+    timed("accumulate_parallel", [&] { sum = accumulate_parallel(v.cbegin(), v.cend(), 0.0); });
+    timed("transform_parallel", [&] { transform_parallel(v.cbegin(), v.cend(), out.begin(), [](double x) { return x * x; }); });
+    timed("inclusive_scan_parallel", [&] { inclusive_scan_parallel(v.cbegin(), v.cend(), out.begin()); });
+    timed("find_parallel (no match)", [&] { find_parallel(v.cbegin(), v.cend(), -1.0); });
+    timed("sort_parallel", [&] { sort_parallel(out.begin(), out.end()); });
+    std::cout << "sum: " << sum << "\n\n";
+
+    print_calls();
+    std::ofstream trace(trace_file);
+    par_trace::write_chrome_trace(trace);
+    if (par_trace::enabled)
+        std::cout << "\ntrace written to " << trace_file << '\n';
+
+    return 0;
+}